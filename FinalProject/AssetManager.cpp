@@ -0,0 +1,55 @@
+#include "AssetManager.h"
+#include "JobSystem.h"
+
+#include <iostream>
+
+AssetManager& AssetManager::instance() {
+    static AssetManager assetManager;
+    return assetManager;
+}
+
+void AssetManager::requestGltf(const std::string& path) {
+    findOrRequest(path);
+}
+
+GltfAsset AssetManager::getGltf(const std::string& path) {
+    std::shared_future<GltfAsset> asset = findOrRequest(path);
+    return asset.get();
+}
+
+void AssetManager::release(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    gltfAssets.erase(path);
+}
+
+std::shared_future<GltfAsset> AssetManager::findOrRequest(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = gltfAssets.find(path);
+    if (it != gltfAssets.end()) return it->second;
+
+    std::shared_future<GltfAsset> asset = JobSystem::instance().submitTask<GltfAsset>([path]() {
+        return loadGltf(path);
+    }).share();
+    gltfAssets[path] = asset;
+    return asset;
+}
+
+GltfAsset AssetManager::loadGltf(const std::string& path) {
+    // One loader per job: TinyGLTF keeps per-load state, while stb_image decodes on any thread
+    tinygltf::TinyGLTF loader;
+    std::shared_ptr<tinygltf::Model> model = std::make_shared<tinygltf::Model>();
+    std::string err;
+    std::string warn;
+    bool res = loader.LoadASCIIFromFile(model.get(), &err, &warn, path);
+
+    // One message per file, so the workers' output does not interleave
+    std::string message;
+    if (!warn.empty()) message += "WARN: " + warn + "\n";
+    if (!err.empty()) message += "ERR: " + err + "\n";
+    message += (res ? "Loaded glTF: " : "Failed to load glTF: ") + path + "\n";
+    if (res) std::cout << message << std::flush;
+    else std::cerr << message << std::flush;
+
+    if (!res) return GltfAsset();
+    return model;
+}
@@ -0,0 +1,43 @@
+#ifndef ASSET_MANAGER_H
+#define ASSET_MANAGER_H
+
+#include <tiny_gltf.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// A parsed glTF file with its buffers loaded and its images decoded. Shared and never modified.
+typedef std::shared_ptr<const tinygltf::Model> GltfAsset;
+
+// Loads glTF files on the job system, one job per file, so the files parse and decode their images
+// side by side. Every path is loaded once and shared by all its users until it is released.
+//
+// Request every file needed as early as possible, then fetch each one on the GL thread right before
+// uploading it: startup then waits for the slowest file instead of the sum of all of them.
+class AssetManager {
+public:
+    static AssetManager& instance();
+
+    // Start loading path on a worker, unless it is cached or already loading
+    void requestGltf(const std::string& path);
+
+    // Wait for path, requesting it first if needed. Returns nullptr if it failed to load.
+    GltfAsset getGltf(const std::string& path);
+
+    // Drop the cache's reference once path is on the GPU. The model is freed when its last user lets
+    // go of it, and a later request loads the file again.
+    void release(const std::string& path);
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_future<GltfAsset>> gltfAssets;
+
+    std::shared_future<GltfAsset> findOrRequest(const std::string& path);
+
+    // Runs on a worker
+    static GltfAsset loadGltf(const std::string& path);
+};
+
+#endif
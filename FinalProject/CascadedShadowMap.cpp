@@ -0,0 +1,139 @@
+#include "CascadedShadowMap.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+#include <render/shader.h>
+
+void CascadedShadowMap::initialize(const std::vector<int>& resolutions, float shadowDistance,
+                                   float splitLambda, float nearDistance) {
+    int cascadeCount = static_cast<int>(resolutions.size());
+    if (cascadeCount > MAX_SHADOW_CASCADES) {
+        std::cerr << "Too many shadow cascades requested, using " << MAX_SHADOW_CASCADES << std::endl;
+        cascadeCount = MAX_SHADOW_CASCADES;
+    }
+
+    depthProgramID = LoadShadersFromFile("../FinalProject/shader/depth.vert", "../FinalProject/shader/depth.frag");
+    if (depthProgramID == 0) std::cerr << "Failed to load depth shaders." << std::endl;
+
+    cascades.resize(cascadeCount);
+    for (int i = 0; i < cascadeCount; ++i) {
+        cascades[i].initialize(resolutions[i], resolutions[i], depthProgramID);
+        cascades[i].debugFilename = "depth_light_" + std::to_string(i) + ".png";
+    }
+
+    // Practical split scheme: blend of logarithmic and uniform splits between near and far
+    splitDistances.resize(cascadeCount + 1);
+    for (int i = 0; i <= cascadeCount; ++i) {
+        float t = static_cast<float>(i) / cascadeCount;
+        float logSplit = nearDistance * std::pow(shadowDistance / nearDistance, t);
+        float uniformSplit = nearDistance + (shadowDistance - nearDistance) * t;
+        splitDistances[i] = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+    }
+}
+
+glm::mat4 CascadedShadowMap::fitCascade(int index, const glm::vec3& cameraPos, const glm::vec3& cameraForward,
+                                        float fovY, float aspect, const glm::vec3& lightDirection) const {
+    const float nearSplit = splitDistances[index];
+    const float farSplit = splitDistances[index + 1];
+    const float resolution = static_cast<float>(cascades[index].getWidth());
+
+    // Bounding sphere of the frustum slice. Its radius only depends on the slice shape, so it
+    // stays constant while the camera turns; rounding it up removes float noise.
+    float tanY = std::tan(fovY * 0.5f);
+    float tanX = tanY * aspect;
+    float halfLength = (farSplit - nearSplit) * 0.5f;
+    float radius = std::sqrt(halfLength * halfLength + farSplit * farSplit * (tanX * tanX + tanY * tanY));
+    radius = std::ceil(radius);
+
+    glm::vec3 center = cameraPos + glm::normalize(cameraForward) * (nearSplit + halfLength);
+
+    // Light orientation without translation; the cascade is positioned in this space. Up is a fixed
+    // world axis, so the light space does not roll as the camera turns and the texel snapping holds.
+    glm::vec3 lightDir = glm::normalize(lightDirection);
+    glm::vec3 lightUp = std::fabs(lightDir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+    glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDir, lightUp);
+
+    // Snap the center to whole texels so static geometry doesn't shimmer as the camera moves
+    glm::vec3 lightSpaceCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+    float texelSize = 2.0f * radius / resolution;
+    lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+    lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
+    lightSpaceCenter.z = std::floor(lightSpaceCenter.z / texelSize) * texelSize;
+
+    glm::mat4 lightProjection = glm::ortho(
+        lightSpaceCenter.x - radius, lightSpaceCenter.x + radius,
+        lightSpaceCenter.y - radius, lightSpaceCenter.y + radius,
+        -lightSpaceCenter.z - radius - casterDepthPadding, -lightSpaceCenter.z + radius
+    );
+
+    return lightProjection * lightRotation;
+}
+
+bool CascadedShadowMap::update(const glm::vec3& cameraPos, const glm::vec3& cameraForward, float fovY, float aspect,
+                               const glm::vec3& lightDirection,
+                               const std::function<void(const ShadowMap&)>& renderCasters) {
+    lastRedrawCount = 0;
+
+    for (int i = 0; i < getCascadeCount(); ++i) {
+        glm::mat4 lightSpaceMatrix = fitCascade(i, cameraPos, cameraForward, fovY, aspect, lightDirection);
+
+        // Cascades that did not move by a texel and had no caster changes keep last frame's map
+        if (!cascades[i].needsUpdate(lightSpaceMatrix)) continue;
+
+        cascades[i].begin(lightSpaceMatrix);
+        renderCasters(cascades[i]);
+        cascades[i].end();
+        ++lastRedrawCount;
+    }
+
+    return lastRedrawCount > 0;
+}
+
+void CascadedShadowMap::invalidate() {
+    for (auto& cascade : cascades) {
+        cascade.invalidate();
+    }
+}
+
+CascadeUniforms CascadedShadowMap::getUniformLocations(GLuint programID) {
+    CascadeUniforms uniforms;
+    uniforms.lightSpaceMatrices = glGetUniformLocation(programID, "lightSpaceMatrices");
+    uniforms.mapSizes = glGetUniformLocation(programID, "shadowMapSizes");
+    uniforms.samplers = glGetUniformLocation(programID, "shadowMaps");
+    uniforms.cascadeCount = glGetUniformLocation(programID, "cascadeCount");
+    return uniforms;
+}
+
+void CascadedShadowMap::bindForSampling(const CascadeUniforms& uniforms, int firstTextureUnit) const {
+    glm::mat4 matrices[MAX_SHADOW_CASCADES];
+    glm::vec2 sizes[MAX_SHADOW_CASCADES];
+    GLint units[MAX_SHADOW_CASCADES];
+
+    const int count = getCascadeCount();
+    for (int i = 0; i < MAX_SHADOW_CASCADES; ++i) {
+        // Unused sampler slots point at the first cascade so every sampler stays valid
+        units[i] = firstTextureUnit + (i < count ? i : 0);
+        if (i >= count) continue;
+
+        glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i);
+        glBindTexture(GL_TEXTURE_2D, cascades[i].getDepthTexture());
+        matrices[i] = cascades[i].getLightSpaceMatrix();
+        sizes[i] = glm::vec2(cascades[i].getWidth(), cascades[i].getHeight());
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniformMatrix4fv(uniforms.lightSpaceMatrices, count, GL_FALSE, &matrices[0][0][0]);
+    glUniform2fv(uniforms.mapSizes, count, &sizes[0][0]);
+    glUniform1iv(uniforms.samplers, MAX_SHADOW_CASCADES, units);
+    glUniform1i(uniforms.cascadeCount, count);
+}
+
+void CascadedShadowMap::cleanup() {
+    for (auto& cascade : cascades) {
+        cascade.cleanup();
+    }
+    cascades.clear();
+    glDeleteProgram(depthProgramID);
+}
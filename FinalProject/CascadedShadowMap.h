@@ -0,0 +1,65 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include "ShadowMap.h"
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Must match MAX_CASCADES in terrain.frag
+const int MAX_SHADOW_CASCADES = 4;
+
+// Uniform locations a receiver program needs to sample the cascades
+struct CascadeUniforms {
+    GLint lightSpaceMatrices = -1;
+    GLint mapSizes = -1;
+    GLint samplers = -1;
+    GLint cascadeCount = -1;
+};
+
+// Directional light shadows split along the view frustum. Each cascade is a ShadowMap fitted
+// to a bounding sphere of one frustum slice and snapped to its texel grid, so it only changes
+// (and is only re-rendered) when the camera moved by at least one texel of that cascade.
+class CascadedShadowMap {
+public:
+    // One entry per cascade, near to far. splitLambda blends logarithmic (1) and uniform (0) splits.
+    void initialize(const std::vector<int>& resolutions, float shadowDistance,
+                    float splitLambda = 0.75f, float nearDistance = 1.0f);
+
+    // Refit every cascade to the camera frustum and redraw the ones that moved or were invalidated.
+    // renderCasters is called once per redrawn cascade, between ShadowMap::begin and end.
+    // Returns true if any cascade was redrawn, so the caller can restore its viewport.
+    bool update(const glm::vec3& cameraPos, const glm::vec3& cameraForward, float fovY, float aspect,
+                const glm::vec3& lightDirection,
+                const std::function<void(const ShadowMap&)>& renderCasters);
+
+    void invalidate();
+
+    // Extra depth toward the light so casters above the slice (the sky cities) still land in the map
+    float casterDepthPadding = 400.0f;
+
+    static CascadeUniforms getUniformLocations(GLuint programID);
+
+    // Bind the cascade depth textures from firstTextureUnit on and set the receiver uniforms
+    void bindForSampling(const CascadeUniforms& uniforms, int firstTextureUnit) const;
+
+    int getCascadeCount() const { return static_cast<int>(cascades.size()); }
+    const ShadowMap& getCascade(int index) const { return cascades[index]; }
+    const std::vector<float>& getSplitDistances() const { return splitDistances; }
+
+    // Number of cascades redrawn by the last update, for profiling
+    int getLastRedrawCount() const { return lastRedrawCount; }
+
+    void cleanup();
+
+private:
+    std::vector<ShadowMap> cascades;
+    std::vector<float> splitDistances;   // cascadeCount + 1 distances along the view direction
+    GLuint depthProgramID = 0;
+    int lastRedrawCount = 0;
+
+    glm::mat4 fitCascade(int index, const glm::vec3& cameraPos, const glm::vec3& cameraForward,
+                         float fovY, float aspect, const glm::vec3& lightDirection) const;
+};
+
+#endif
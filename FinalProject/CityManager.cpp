@@ -1,52 +1,42 @@
 #include "CityManager.h"
+#include "TerrainManager.h"
+#include "AssetManager.h"
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstddef>
 #include <random>
 #include <iostream>
 #include <render/shader.h>
 
-bool CityManager::loadModel(tinygltf::Model &model, const char *filename) {
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-
-    bool res = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
-    if (!warn.empty()) {
-        std::cout << "WARN: " << warn << std::endl;
+void CityManager::requestAssets() {
+    if (!modelPack.isOpen() && modelPack.open(MODEL_PACK)) {
+        std::cout << "Mapped model pack: " << MODEL_PACK << std::endl;
     }
 
-    if (!err.empty()) {
-        std::cout << "ERR: " << err << std::endl;
+    const std::string* files[2 * LOD_COUNT] = { &CITY_LOD0, &CITY_LOD1, &CITY_LOD2, &HULL_LOD0, &HULL_LOD1, &HULL_LOD2 };
+    for (int i = 0; i < 2 * LOD_COUNT; i++) {
+        if (!modelPack.findModel(*files[i])) AssetManager::instance().requestGltf(*files[i]);
     }
-
-    if (!res)
-        std::cout << "Failed to load glTF: " << filename << std::endl;
-    else
-        std::cout << "Loaded glTF: " << filename << std::endl;
-
-    return res;
 }
 
-void CityManager::uploadModel(const tinygltf::Model &model, GltfRenderData &renderData) {
-    renderData.model = model;
-
+void CityManager::uploadModel(const tinygltf::Model &model, GltfRenderData &renderData, GLuint instanceBufferID) {
     // Upload buffers to GPU
-    for (const auto& bufferView : renderData.model.bufferViews) {
+    for (const auto& bufferView : model.bufferViews) {
         GLuint bufferID;
         glGenBuffers(1, &bufferID);
         glBindBuffer(bufferView.target, bufferID);
 
         glBufferData(bufferView.target,
                      bufferView.byteLength,
-                     &renderData.model.buffers[bufferView.buffer].data[bufferView.byteOffset],
+                     &model.buffers[bufferView.buffer].data[bufferView.byteOffset],
                      GL_STATIC_DRAW);
 
         renderData.bufferIDs.push_back(bufferID);
     }
 
     // Upload textures to GPU
-    for (const auto& texture : renderData.model.textures) {
-        const auto& image = renderData.model.images[texture.source];
+    for (const auto& texture : model.textures) {
+        const auto& image = model.images[texture.source];
 
         GLuint textureID;
         glGenTextures(1, &textureID);
@@ -68,39 +58,195 @@ void CityManager::uploadModel(const tinygltf::Model &model, GltfRenderData &rend
 
         renderData.textureIDs.push_back(textureID);
     }
+
+    // One VAO per primitive with everything its draw needs, so drawing never searches the glTF model
+    const char* attributeNames[3] = { "POSITION", "NORMAL", "TEXCOORD_0" };
+    const int attributeSizes[3] = { 3, 3, 2 };
+    for (const auto& node : model.nodes) {
+        if (node.mesh < 0) continue;
+        const auto& mesh = model.meshes[node.mesh];
+
+        for (const auto& primitive : mesh.primitives) {
+            if (primitive.indices < 0) continue;
+
+            PreparedPrimitive prepared;
+            glGenVertexArrays(1, &prepared.vertexArrayID);
+            glBindVertexArray(prepared.vertexArrayID);
+
+            // Locations match city.vert
+            for (int location = 0; location < 3; ++location) {
+                auto attribute = primitive.attributes.find(attributeNames[location]);
+                if (attribute == primitive.attributes.end()) continue;
+
+                const auto& accessor   = model.accessors[attribute->second];
+                const auto& bufferView = model.bufferViews[accessor.bufferView];
+                glBindBuffer(GL_ARRAY_BUFFER, renderData.bufferIDs[accessor.bufferView]);
+                glVertexAttribPointer(location, attributeSizes[location], GL_FLOAT, GL_FALSE, bufferView.byteStride,
+                    reinterpret_cast<void*>(accessor.byteOffset));
+                glEnableVertexAttribArray(location);
+            }
+
+            bindInstanceAttributes(instanceBufferID);
+
+            const auto& indexAccessor = model.accessors[primitive.indices];
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderData.bufferIDs[indexAccessor.bufferView]);
+            prepared.indexCount = static_cast<GLsizei>(indexAccessor.count);
+            prepared.indexType = indexAccessor.componentType;
+            prepared.indexOffset = indexAccessor.byteOffset;
+
+            glBindVertexArray(0);
+
+            if (primitive.material >= 0) {
+                int textureIndex = model.materials[primitive.material].pbrMetallicRoughness.baseColorTexture.index;
+                if (textureIndex >= 0 && textureIndex < (int)renderData.textureIDs.size()) {
+                    prepared.textureID = renderData.textureIDs[textureIndex];
+                }
+            }
+
+            renderData.primitives.push_back(prepared);
+        }
+    }
 }
 
-void CityManager::initialize(int numberOfCities) {
-    City::programID = LoadShadersFromFile("../FinalProject/shader/model.vert", "../FinalProject/shader/model.frag");
-    if (City::programID == 0) {
-        std::cerr << "Failed to load shaders." << std::endl;
+bool CityManager::uploadPackedModel(const std::string& file, GltfRenderData &renderData, GLuint instanceBufferID) {
+    const PackModel* model = modelPack.findModel(file);
+    if (!model) return false;
+
+    for (uint32_t i = 0; i < model->primitiveCount; ++i) {
+        const PackPrimitive& primitive = modelPack.getPrimitive(model->firstPrimitive + i);
+        size_t indexSize = primitive.indexType == PACK_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+        PreparedPrimitive prepared;
+        glGenVertexArrays(1, &prepared.vertexArrayID);
+        glBindVertexArray(prepared.vertexArrayID);
+
+        // Both buffers are filled from the mapping; the OS pages the blobs in as the driver reads them
+        GLuint buffers[2];
+        glGenBuffers(2, buffers);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBufferData(GL_ARRAY_BUFFER, primitive.vertexCount * sizeof(PackVertex), modelPack.at(primitive.vertexOffset), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, primitive.indexCount * indexSize, modelPack.at(primitive.indexOffset), GL_STATIC_DRAW);
+        renderData.bufferIDs.push_back(buffers[0]);
+        renderData.bufferIDs.push_back(buffers[1]);
+
+        // Locations match city.vert
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackVertex), reinterpret_cast<void*>(offsetof(PackVertex, position)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(PackVertex), reinterpret_cast<void*>(offsetof(PackVertex, normal)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(PackVertex), reinterpret_cast<void*>(offsetof(PackVertex, texCoord)));
+        for (int location = 0; location < 3; ++location) glEnableVertexAttribArray(location);
+
+        bindInstanceAttributes(instanceBufferID);
+        glBindVertexArray(0);
+
+        prepared.indexCount = static_cast<GLsizei>(primitive.indexCount);
+        prepared.indexType = primitive.indexType;
+        prepared.indexOffset = 0;
+        if (primitive.texture >= 0) prepared.textureID = uploadPackedTexture(primitive.texture);
+
+        renderData.primitives.push_back(prepared);
+    }
+    return true;
+}
+
+GLuint CityManager::uploadPackedTexture(int texture) {
+    packTextureIDs.resize(modelPack.getTextureCount(), 0);
+    if (packTextureIDs[texture] != 0) return packTextureIDs[texture];
+
+    // Every mip level is in the pack, so there is nothing to generate
+    const PackTexture& packTexture = modelPack.getTexture(texture);
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for (uint32_t level = 0; level < packTexture.levelCount; ++level) {
+        const PackLevel& packLevel = modelPack.getLevel(packTexture.firstLevel + level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, packLevel.width, packLevel.height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, modelPack.at(packLevel.offset));
     }
 
-    loadModel(cityLOD0, CITY_LOD0.c_str());
-    loadModel(cityLOD1, CITY_LOD1.c_str());
-    loadModel(cityLOD2, CITY_LOD2.c_str());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, packTexture.levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    loadModel(hullLOD0, HULL_LOD0.c_str());
-    loadModel(hullLOD1, HULL_LOD1.c_str());
-    loadModel(hullLOD2, HULL_LOD2.c_str());
+    packTextureIDs[texture] = textureID;
+    return textureID;
+}
 
-    uploadModel(cityLOD0, cityLOD0Data);
-    uploadModel(cityLOD1, cityLOD1Data);
-    uploadModel(cityLOD2, cityLOD2Data);
+void CityManager::bindInstanceAttributes(GLuint instanceBufferID) {
+    // A mat4 attribute takes four consecutive locations, one column each, advancing once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+    for (int column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+            reinterpret_cast<void*>(sizeof(glm::vec4) * column));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+}
 
-    uploadModel(hullLOD0, hullLOD0Data);
-    uploadModel(hullLOD1, hullLOD1Data);
-    uploadModel(hullLOD2, hullLOD2Data);
+void CityManager::initialize(int numberOfCities, const TerrainManager& terrain) {
+    this->terrain = &terrain;
+
+    programID = LoadShadersFromFile("../FinalProject/shader/city.vert", "../FinalProject/shader/model.frag");
+    if (programID == 0) {
+        std::cerr << "Failed to load shaders." << std::endl;
+    }
+    vpMatrixID = glGetUniformLocation(programID, "VP");
+    lightDirID = glGetUniformLocation(programID, "lightDir");
+    lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
+    cameraPosID = glGetUniformLocation(programID, "cameraPos");
+    textureSamplerID = glGetUniformLocation(programID, "modelTexture");
+
+    depthProgramID = LoadShadersFromFile("../FinalProject/shader/city_depth.vert", "../FinalProject/shader/depth.frag");
+    if (depthProgramID == 0) {
+        std::cerr << "Failed to load city depth shaders." << std::endl;
+    }
+    depthLightSpaceMatrixID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
+
+    // Each model's VAOs read the instance buffer of its batch, so the buffers come first
+    GltfRenderData* cityData[LOD_COUNT] = { &cityLOD0Data, &cityLOD1Data, &cityLOD2Data };
+    GltfRenderData* hullData[LOD_COUNT] = { &hullLOD0Data, &hullLOD1Data, &hullLOD2Data };
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        cityBatches[lod].renderData = cityData[lod];
+        hullBatches[lod].renderData = hullData[lod];
+        glGenBuffers(1, &cityBatches[lod].bufferID);
+        glGenBuffers(1, &hullBatches[lod].bufferID);
+    }
+
+    // Packed models upload straight from the mapping. The others load on the workers at once; each
+    // is uploaded as soon as it is ready and then released, so its buffers and decoded images are
+    // freed once they are on the GPU.
+    requestAssets();
+    const std::string* files[2 * LOD_COUNT] = { &CITY_LOD0, &CITY_LOD1, &CITY_LOD2, &HULL_LOD0, &HULL_LOD1, &HULL_LOD2 };
+    InstanceBatch* batches[2 * LOD_COUNT] = { &cityBatches[0], &cityBatches[1], &cityBatches[2], &hullBatches[0], &hullBatches[1], &hullBatches[2] };
+    AssetManager& assets = AssetManager::instance();
+    for (int i = 0; i < 2 * LOD_COUNT; i++) {
+        if (uploadPackedModel(*files[i], *batches[i]->renderData, batches[i]->bufferID)) continue;
+
+        GltfAsset model = assets.getGltf(*files[i]);
+        if (model) uploadModel(*model, *batches[i]->renderData, batches[i]->bufferID);
+        assets.release(*files[i]);
+    }
+    modelPack.close();
 
     generateCities(numberOfCities);
 }
 
 void CityManager::generateCities(int numberOfCities) {
+    // Place every city first, then look up the ground under all of them at once
+    std::vector<float> xs(numberOfCities), zs(numberOfCities), ground(numberOfCities);
     for (int i = 0; i < numberOfCities; i++) {
-
         float theta = 2.0f * M_PI * randomFloat(0,1);
         float r = viewRadius * sqrt(randomFloat(0,1));
-        glm::vec3 position(r * cos(theta), randomFloat(150, 200), r * sin(theta));
+        xs[i] = r * cos(theta);
+        zs[i] = r * sin(theta);
+    }
+    terrain->sampleHeights(xs.data(), zs.data(), numberOfCities, ground.data());
+
+    for (int i = 0; i < numberOfCities; i++) {
+        float hoverHeight = randomFloat(150, 200);
+        glm::vec3 position(xs[i], ground[i] + hoverHeight, zs[i]);
         float size = randomFloat(5, 10);
         float rotation = randomFloat(0, 360);
 
@@ -117,23 +263,18 @@ void CityManager::generateCities(int numberOfCities) {
         hull.yOffset = offset;
         hull.up = up;
 
-        city.renderData = &cityLOD0Data;
-        hull.renderData = &hullLOD0Data;
-
         SkyCity skyCity;
         skyCity.city = city;
         skyCity.hull = hull;
+        skyCity.hoverHeight = hoverHeight;
 
         cities.push_back(skyCity);
     }
+    instancesDirty = true;
 }
 
-void CityManager::render(glm::mat4& vp, glm::vec3 lightDirection, glm::vec3 lightIntensity, glm::vec3 cameraPos) {
+bool CityManager::update(const glm::vec3& cameraPos) {
     for (auto& skyCity : cities) {
-        glUseProgram(City::programID);
-        glUniform3fv(glGetUniformLocation(City::programID, "lightDir"), 1, &lightDirection[0]);
-        glUniform3fv(glGetUniformLocation(City::programID, "lightIntensity"), 1, &lightIntensity[0]);
-
         glm::vec3 oldPosition = skyCity.city.position;
         float hull_offset = oldPosition.y - skyCity.hull.position.y;
         glm::vec3 cameraToOldPos = oldPosition - cameraPos;
@@ -143,40 +284,94 @@ void CityManager::render(glm::mat4& vp, glm::vec3 lightDirection, glm::vec3 ligh
         if (distanceXY > viewRadius) {
             glm::vec3 normalizedXY = glm::normalize(glm::vec3(cameraToOldPos.x, 0, cameraToOldPos.z));
             glm::vec3 newPosition = cameraPos - normalizedXY * viewRadius;
-            newPosition.y = oldPosition.y;
+            newPosition.y = terrain->sampleHeight(newPosition.x, newPosition.z) + skyCity.hoverHeight;
 
             skyCity.city.updatePosition(newPosition);
             skyCity.hull.updatePosition(newPosition - glm::vec3(0,hull_offset,0));
-            continue;
+            instancesDirty = true;
         }
 
-        float distance = glm::distance(oldPosition, cameraPos);
+        float distance = glm::distance(skyCity.city.position, cameraPos);
+        int lod = 0;
+        if (distance > LOD1Radius) lod = 2;
+        else if (distance > LOD0Radius) lod = 1;
 
-        // LOD2
-        if (distance > LOD1Radius) {
-            skyCity.city.renderData = &cityLOD2Data;
-            skyCity.hull.renderData = &hullLOD2Data;
+        if (lod != skyCity.lod) {
+            skyCity.lod = lod;
+            instancesDirty = true;
         }
+    }
+
+    if (!instancesDirty) return false;
+    rebuildInstances();
+    return true;
+}
+
+void CityManager::rebuildInstances() {
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        cityBatches[lod].matrices.clear();
+        hullBatches[lod].matrices.clear();
+    }
+    for (const auto& skyCity : cities) {
+        cityBatches[skyCity.lod].matrices.push_back(skyCity.city.modelMatrix);
+        hullBatches[skyCity.lod].matrices.push_back(skyCity.hull.modelMatrix);
+    }
 
-        // LOD1
-        else if (distance > LOD0Radius) {
-            skyCity.city.renderData = &cityLOD1Data;
-            skyCity.hull.renderData = &hullLOD1Data;
+    // Orphan and refill; a rebuild only happens when cities move or change LOD
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        for (InstanceBatch* batch : { &cityBatches[lod], &hullBatches[lod] }) {
+            glBindBuffer(GL_ARRAY_BUFFER, batch->bufferID);
+            glBufferData(GL_ARRAY_BUFFER, batch->matrices.size() * sizeof(glm::mat4),
+                         batch->matrices.empty() ? nullptr : batch->matrices.data(), GL_DYNAMIC_DRAW);
         }
+    }
+    instancesDirty = false;
+}
 
-        // LOD0
-        else {
-            skyCity.city.renderData = &cityLOD0Data;
-            skyCity.hull.renderData = &hullLOD0Data;
+void CityManager::render(glm::mat4& vp, glm::vec3 lightDirection, glm::vec3 lightIntensity, glm::vec3 cameraPos) {
+    glUseProgram(programID);
+    glUniformMatrix4fv(vpMatrixID, 1, GL_FALSE, &vp[0][0]);
+    glUniform3fv(lightDirID, 1, &lightDirection[0]);
+    glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
+    glUniform3fv(cameraPosID, 1, &cameraPos[0]);
+    glUniform1i(textureSamplerID, 0);
+
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        for (const InstanceBatch* batch : { &cityBatches[lod], &hullBatches[lod] }) {
+            City::drawInstanced(*batch->renderData, static_cast<GLsizei>(batch->matrices.size()));
         }
+    }
+}
 
-        skyCity.city.render(vp, lightDirection, lightIntensity, cameraPos);
-        skyCity.hull.render(vp, lightDirection, lightIntensity, cameraPos);
+void CityManager::renderDepth(const ShadowMap& shadowMap) {
+    glUseProgram(depthProgramID);
+    glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, &shadowMap.getLightSpaceMatrix()[0][0]);
+
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        for (const InstanceBatch* batch : { &cityBatches[lod], &hullBatches[lod] }) {
+            City::drawInstanced(*batch->renderData, static_cast<GLsizei>(batch->matrices.size()), true);
+        }
     }
+
+    // Casters after this one draw with the shadow map's own program
+    glUseProgram(shadowMap.getDepthProgramID());
 }
 
 void CityManager::cleanup() {
-    glDeleteProgram(City::programID);
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        for (InstanceBatch* batch : { &cityBatches[lod], &hullBatches[lod] }) {
+            GltfRenderData& renderData = *batch->renderData;
+            for (const PreparedPrimitive& primitive : renderData.primitives) {
+                glDeleteVertexArrays(1, &primitive.vertexArrayID);
+            }
+            if (!renderData.bufferIDs.empty()) glDeleteBuffers(static_cast<GLsizei>(renderData.bufferIDs.size()), renderData.bufferIDs.data());
+            if (!renderData.textureIDs.empty()) glDeleteTextures(static_cast<GLsizei>(renderData.textureIDs.size()), renderData.textureIDs.data());
+            glDeleteBuffers(1, &batch->bufferID);
+        }
+    }
+    if (!packTextureIDs.empty()) glDeleteTextures(static_cast<GLsizei>(packTextureIDs.size()), packTextureIDs.data());
+    glDeleteProgram(programID);
+    glDeleteProgram(depthProgramID);
 }
 
 float CityManager::randomFloat(float min, float max) {
@@ -3,28 +3,71 @@
 
 #include "model.h"
 #include "city.h"
+#include "ShadowMap.h"
+#include "ModelPack.h"
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
 
+class TerrainManager;
+
 struct SkyCity {
     City city;
     City hull;
+    float hoverHeight = 0.0f;  // Above the terrain below the city
+    int lod = 0;
 };
 
 class CityManager {
 public:
-    void initialize(int numberOfCities);
+    // Map the model pack, and start loading the city and hull models it lacks in the background;
+    // initialize waits for them
+    void requestAssets();
+
+    // Cities float above the terrain, which must outlive the manager
+    void initialize(int numberOfCities, const TerrainManager& terrain);
 
     void generateCities(int count);
 
+    // Move cities that fell behind the camera to the far side of the view, pick each city's LOD, and
+    // rebuild the instance buffers if either changed. Call once per frame before the passes.
+    // Returns true when the instances changed, so the shadows need a redraw.
+    bool update(const glm::vec3& cameraPos);
+
+    // One instanced draw per LOD and primitive, for every city at once
     void render(glm::mat4& vp, glm::vec3 lightDirection, glm::vec3 lightIntensity, glm::vec3 cameraPos);
+    void renderDepth(const ShadowMap& shadowMap);
 
     void cleanup();
 
 private:
     std::vector<SkyCity> cities;
+    const TerrainManager* terrain = nullptr;
+
+    static const int LOD_COUNT = 3;
+
+    // Model matrices of the cities or hulls drawn with one model at one LOD
+    struct InstanceBatch {
+        GltfRenderData* renderData = nullptr;
+        GLuint bufferID = 0;
+        std::vector<glm::mat4> matrices;
+    };
+    InstanceBatch cityBatches[LOD_COUNT];
+    InstanceBatch hullBatches[LOD_COUNT];
+    bool instancesDirty = true;
+
+    GLuint programID = 0;
+    GLint vpMatrixID = -1;
+    GLint lightDirID = -1;
+    GLint lightIntensityID = -1;
+    GLint cameraPosID = -1;
+    GLint textureSamplerID = -1;
+
+    GLuint depthProgramID = 0;
+    GLint depthLightSpaceMatrixID = -1;
+
+    void rebuildInstances();
 
     const float LOD0Radius = 450;
     const float LOD1Radius = 1000;
@@ -39,15 +82,24 @@ private:
     const std::string HULL_LOD1 = "../FinalProject/assets/model/hull/hull_LOD1.gltf";
     const std::string HULL_LOD2 = "../FinalProject/assets/model/hull/hull_LOD2.gltf";
 
+    // Built by tools/model_pack from the files above; the glTF files are the fallback for models it lacks
+    const std::string MODEL_PACK = "../FinalProject/assets/model/models.pack";
+    ModelPack modelPack;                  // Mapped from requestAssets until initialize has uploaded
+    std::vector<GLuint> packTextureIDs;   // One per pack texture, shared by the LODs that use its image
+
     GltfRenderData cityLOD0Data, cityLOD1Data, cityLOD2Data;
     GltfRenderData hullLOD0Data, hullLOD1Data, hullLOD2Data;
 
-    tinygltf::Model cityLOD0, cityLOD1, cityLOD2;
-    tinygltf::Model hullLOD0, hullLOD1, hullLOD2;
+    // Uploads the buffers and textures and prepares the primitives' VAOs, reading instance matrices from instanceBufferID.
+    // Nothing refers to model afterwards, so the caller can free it.
+    void uploadModel(const tinygltf::Model &model, GltfRenderData &renderData, GLuint instanceBufferID);
 
-    bool loadModel(tinygltf::Model &model, const char *filename);
+    // Same as uploadModel, straight from the mapped pack. Returns false if the pack lacks file.
+    bool uploadPackedModel(const std::string& file, GltfRenderData &renderData, GLuint instanceBufferID);
+    GLuint uploadPackedTexture(int texture);
 
-    void uploadModel(const tinygltf::Model &model, GltfRenderData &renderData);
+    // Instance matrices at attributes 3 to 6, for the bound VAO
+    void bindInstanceAttributes(GLuint instanceBufferID);
 
     float randomFloat(float min, float max);
 };
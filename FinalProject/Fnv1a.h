@@ -0,0 +1,23 @@
+#ifndef FNV1A_H
+#define FNV1A_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a over raw bytes. Shared by the terrain cache and the noise graph, whose hashes end
+// up in cache file names and headers, so both must hash the same way.
+struct Fnv1a {
+    uint64_t hash = 14695981039346656037ull;
+
+    void add(const void* bytes, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(bytes);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    template <typename T>
+    void add(const T& value) { add(&value, sizeof(T)); }
+};
+
+#endif
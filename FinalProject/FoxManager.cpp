@@ -1,16 +1,29 @@
 #include "FoxManager.h"
+#include "TerrainManager.h"
+
+namespace {
+
+// The fox model is drawn at this scale, so foxPosition is in model units
+const float FOX_SCALE = 0.05f;
+
+} // namespace
+
+void FoxManager::requestAssets() {
+    fox.requestAssets();
+}
 
 void FoxManager::initialize() {
     fox.initialize();
     foxPosition = glm::vec3(0.0f, 0, 0.0f);
-    modelMatrix = glm::scale(modelMatrix,glm::vec3(0.05));
+    modelMatrix = glm::scale(modelMatrix,glm::vec3(FOX_SCALE));
     modelMatrix = glm::translate(modelMatrix,foxPosition);
 }
 
-void FoxManager::update(float deltaTime) {
+void FoxManager::update(float deltaTime, const TerrainManager& terrain) {
     fox.update(deltaTime);
     foxPosition.z += 1;
-    modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.05f));
+    foxPosition.y = terrain.sampleHeight(foxPosition.x * FOX_SCALE, foxPosition.z * FOX_SCALE) / FOX_SCALE;
+    modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(FOX_SCALE));
     modelMatrix = glm::translate(modelMatrix, foxPosition);
 }
 
@@ -18,6 +31,10 @@ void FoxManager::render(glm::mat4 cameraMatrix, glm::vec3 lightPosition, glm::ve
     fox.render(modelMatrix, cameraMatrix, lightPosition, lightIntensity);
 }
 
+void FoxManager::renderDepth(const ShadowMap& shadowMap) {
+    fox.renderDepth(modelMatrix, shadowMap);
+}
+
 void FoxManager::cleanup() {
     fox.cleanup();
 }
\ No newline at end of file
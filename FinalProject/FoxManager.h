@@ -4,15 +4,21 @@
 #include "animation.h"
 #include <glm/gtc/matrix_transform.hpp>
 
+class TerrainManager;
+
 class FoxManager {
 public:
     MyBot fox;
     glm::vec3 foxPosition = glm::vec3(0.0f);
     glm::mat4 modelMatrix = glm::mat4(1.0f);
 
+    // Start loading the fox model in the background; initialize waits for it
+    void requestAssets();
     void initialize();
-    void update(float deltaTime);
+    // Walks the fox forward, keeping its feet on the terrain
+    void update(float deltaTime, const TerrainManager& terrain);
     void render(glm::mat4 cameraMatrix, glm::vec3 lightPosition, glm::vec3 lightIntensity);
+    void renderDepth(const ShadowMap& shadowMap);
     void cleanup();
 };
 
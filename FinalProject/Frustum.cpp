@@ -0,0 +1,33 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    // Gribb-Hartmann: each plane is the fourth row of the matrix plus or minus one of the others.
+    // glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+        planes[2 * axis] = rows[3] + rows[axis];
+        planes[2 * axis + 1] = rows[3] - rows[axis];
+    }
+
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax, bool testDepth) const {
+    const int planeCount = testDepth ? 6 : 4;
+    for (int i = 0; i < planeCount; ++i) {
+        const glm::vec4& plane = planes[i];
+
+        // The box corner furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                         plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                         plane.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Clip planes of a view-projection matrix, for testing bounding boxes on the CPU.
+// Planes point inwards: left, right, bottom, top, near, far.
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // False only when the box is entirely outside one of the planes. Shadow passes skip the
+    // near and far planes, since casters in front of the light's near plane still cast.
+    bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax, bool testDepth = true) const;
+
+private:
+    glm::vec4 planes[6];
+};
+
+#endif
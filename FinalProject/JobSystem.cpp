@@ -0,0 +1,155 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+CancelToken makeCancelToken() {
+    return CancelToken(new std::atomic<bool>(false));
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+    : pendingJobs(0), activeJobs(0), nextQueue(0)
+{
+    if (workerCount == 0) {
+        // Leave one core for the render thread
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (unsigned int i = 0; i < workerCount; ++i) {
+        queues.emplace_back(new WorkerQueue());
+    }
+    for (unsigned int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+void JobSystem::submit(std::function<void()> job, CancelToken token) {
+    Job entry;
+    entry.function = std::move(job);
+    entry.token = std::move(token);
+    entry.submitted = std::chrono::steady_clock::now();
+
+    // Count the job before it becomes visible: a worker may pop and run it, decrementing the
+    // counter, as soon as it is queued. Incrementing under the wake mutex means a worker about to
+    // sleep cannot miss it.
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        ++pendingJobs;
+    }
+
+    unsigned int index = nextQueue++ % static_cast<unsigned int>(queues.size());
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->jobs.push_back(std::move(entry));
+    }
+    wakeCondition.notify_one();
+}
+
+bool JobSystem::popJob(unsigned int index, Job& job) {
+    WorkerQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+
+    // Own queue is served in submission order so callers can prioritise by submitting first
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    return true;
+}
+
+bool JobSystem::stealJob(unsigned int index, Job& job) {
+    const unsigned int count = static_cast<unsigned int>(queues.size());
+    for (unsigned int offset = 1; offset < count; ++offset) {
+        WorkerQueue& victim = *queues[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+
+        // Steal from the opposite end to the owner to keep contention low
+        job = std::move(victim.jobs.back());
+        victim.jobs.pop_back();
+
+        std::lock_guard<std::mutex> statsLock(statsMutex);
+        ++stolenJobs;
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::runJob(Job& job) {
+    --pendingJobs;
+
+    if (isCancelled(job.token)) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        ++cancelledJobs;
+        return;
+    }
+
+    ++activeJobs;
+    job.function();
+    --activeJobs;
+
+    double latencyMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - job.submitted).count();
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    ++completedJobs;
+    ++windowJobs;
+    windowLatencyMs += latencyMs;
+    windowMaxLatencyMs = std::max(windowMaxLatencyMs, latencyMs);
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    while (true) {
+        Job job;
+        if (popJob(index, job) || stealJob(index, job)) {
+            runJob(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this]() { return !running || pendingJobs > 0; });
+        if (!running && pendingJobs == 0) return;
+    }
+}
+
+JobStats JobSystem::getStats(bool resetLatencyWindow) {
+    JobStats stats;
+    stats.queueDepth = pendingJobs;
+    stats.activeJobs = activeJobs;
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.completed = completedJobs;
+    stats.cancelled = cancelledJobs;
+    stats.stolen = stolenJobs;
+    stats.averageLatencyMs = windowJobs > 0 ? windowLatencyMs / windowJobs : 0.0;
+    stats.maxLatencyMs = windowMaxLatencyMs;
+
+    if (resetLatencyWindow) {
+        windowJobs = 0;
+        windowLatencyMs = 0.0;
+        windowMaxLatencyMs = 0.0;
+    }
+    return stats;
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        if (!running) return;
+        running = false;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    workers.clear();
+}
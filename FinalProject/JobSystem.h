@@ -0,0 +1,104 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared flag that lets the owner of a job tell it that its result is no longer wanted.
+// Jobs that have not started yet are dropped; running jobs may poll it and return early.
+typedef std::shared_ptr<std::atomic<bool>> CancelToken;
+
+CancelToken makeCancelToken();
+
+inline bool isCancelled(const CancelToken& token) {
+    return token && token->load(std::memory_order_relaxed);
+}
+
+struct JobStats {
+    size_t queueDepth = 0;               // jobs waiting in all worker queues
+    size_t activeJobs = 0;               // jobs currently executing
+    unsigned long long completed = 0;    // jobs that ran to completion
+    unsigned long long cancelled = 0;    // jobs dropped before they started
+    unsigned long long stolen = 0;       // jobs taken from another worker's queue
+    double averageLatencyMs = 0.0;       // submit -> finish, over the current stats window
+    double maxLatencyMs = 0.0;
+};
+
+// Persistent pool of worker threads, one per spare core. Every worker owns a queue;
+// submissions are spread round-robin and idle workers steal from the back of the
+// other queues, so a burst of jobs from the render thread never spawns new threads.
+class JobSystem {
+public:
+    static JobSystem& instance();
+
+    explicit JobSystem(unsigned int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void submit(std::function<void()> job, CancelToken token = CancelToken());
+
+    // Submit a job that produces a value. If the job is cancelled before it starts,
+    // the future becomes ready with a broken_promise error instead of a value.
+    template <typename T>
+    std::future<T> submitTask(std::function<T()> task, CancelToken token = CancelToken()) {
+        std::shared_ptr<std::packaged_task<T()>> packaged(new std::packaged_task<T()>(task));
+        std::future<T> result = packaged->get_future();
+        submit([packaged]() { (*packaged)(); }, token);
+        return result;
+    }
+
+    // Snapshot of the queue and latency counters. Passing true starts a new latency window.
+    JobStats getStats(bool resetLatencyWindow = false);
+
+    unsigned int getWorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+    // Finish all queued jobs and join the workers.
+    void shutdown();
+
+private:
+    struct Job {
+        std::function<void()> function;
+        CancelToken token;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<size_t> pendingJobs;
+    std::atomic<size_t> activeJobs;
+    std::atomic<unsigned int> nextQueue;
+    bool running = true;
+
+    std::mutex statsMutex;
+    unsigned long long completedJobs = 0;
+    unsigned long long cancelledJobs = 0;
+    unsigned long long stolenJobs = 0;
+    unsigned long long windowJobs = 0;
+    double windowLatencyMs = 0.0;
+    double windowMaxLatencyMs = 0.0;
+
+    void workerLoop(unsigned int index);
+    bool popJob(unsigned int index, Job& job);
+    bool stealJob(unsigned int index, Job& job);
+    void runJob(Job& job);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mapped = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) UnmapViewOfFile(mapped);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mapped = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    fileDescriptor = fd;
+    mapped = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) munmap(const_cast<unsigned char*>(mapped), length);
+    if (fileDescriptor >= 0) ::close(fileDescriptor);
+    mapped = nullptr;
+    fileDescriptor = -1;
+    length = 0;
+}
+
+#endif
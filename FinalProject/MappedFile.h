@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, using mmap on POSIX and file mappings on Windows.
+// The pages are loaded lazily by the OS, so data() can be handed straight to glBufferData.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file is missing, empty or cannot be mapped
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return mapped; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* mapped = nullptr;
+    size_t length = 0;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+#endif
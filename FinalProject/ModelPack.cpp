@@ -0,0 +1,99 @@
+#include "ModelPack.h"
+
+#include <cstring>
+#include <iostream>
+
+bool ModelPack::open(const std::string& path) {
+    close();
+    if (!file.open(path)) return false;
+
+    if (file.size() < sizeof(PackHeader)) {
+        std::cerr << "Model pack " << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    header = reinterpret_cast<const PackHeader*>(file.data());
+    const unsigned char* tables = file.data() + sizeof(PackHeader);
+    models = reinterpret_cast<const PackModel*>(tables);
+    primitives = reinterpret_cast<const PackPrimitive*>(models + header->modelCount);
+    textures = reinterpret_cast<const PackTexture*>(primitives + header->primitiveCount);
+    levels = reinterpret_cast<const PackLevel*>(textures + header->textureCount);
+
+    if (!validate()) {
+        std::cerr << "Model pack " << path << " is invalid or was written by another version, rebuild it with model_pack" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ModelPack::close() {
+    file.close();
+    header = nullptr;
+    models = nullptr;
+    primitives = nullptr;
+    textures = nullptr;
+    levels = nullptr;
+}
+
+const PackModel* ModelPack::findModel(const std::string& name) const {
+    if (!header) return nullptr;
+    for (uint32_t i = 0; i < header->modelCount; ++i) {
+        if (name == models[i].name) return &models[i];
+    }
+    return nullptr;
+}
+
+bool ModelPack::validate() const {
+    const uint64_t size = file.size();
+    auto inFile = [size](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+
+    if (std::memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0
+        || header->version != PACK_VERSION
+        || header->headerSize != sizeof(PackHeader)
+        || header->fileSize != size) {
+        return false;
+    }
+
+    // The counts come from the file, so the table size is computed in 64 bits before it is trusted
+    uint64_t tableBytes = static_cast<uint64_t>(header->modelCount) * sizeof(PackModel)
+                        + static_cast<uint64_t>(header->primitiveCount) * sizeof(PackPrimitive)
+                        + static_cast<uint64_t>(header->textureCount) * sizeof(PackTexture)
+                        + static_cast<uint64_t>(header->levelCount) * sizeof(PackLevel);
+    if (!inFile(sizeof(PackHeader), tableBytes)) return false;
+
+    for (uint32_t i = 0; i < header->modelCount; ++i) {
+        const PackModel& model = models[i];
+        if (std::memchr(model.name, 0, PACK_NAME_LENGTH) == nullptr) return false;
+        if (model.firstPrimitive > header->primitiveCount
+            || model.primitiveCount > header->primitiveCount - model.firstPrimitive) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->primitiveCount; ++i) {
+        const PackPrimitive& primitive = primitives[i];
+        uint64_t indexSize = primitive.indexType == PACK_UNSIGNED_SHORT ? 2 : 4;
+        if (primitive.indexType != PACK_UNSIGNED_SHORT && primitive.indexType != PACK_UNSIGNED_INT) return false;
+        if (!inFile(primitive.vertexOffset, static_cast<uint64_t>(primitive.vertexCount) * sizeof(PackVertex))) return false;
+        if (!inFile(primitive.indexOffset, primitive.indexCount * indexSize)) return false;
+        if (primitive.texture < -1 || primitive.texture >= static_cast<int64_t>(header->textureCount)) return false;
+    }
+
+    for (uint32_t i = 0; i < header->textureCount; ++i) {
+        const PackTexture& texture = textures[i];
+        if (texture.levelCount == 0 || texture.firstLevel > header->levelCount
+            || texture.levelCount > header->levelCount - texture.firstLevel) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->levelCount; ++i) {
+        const PackLevel& level = levels[i];
+        if (!inFile(level.offset, static_cast<uint64_t>(level.width) * level.height * 4)) return false;
+    }
+    return true;
+}
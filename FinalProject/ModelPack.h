@@ -0,0 +1,105 @@
+#ifndef MODEL_PACK_H
+#define MODEL_PACK_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+// Static glTF models preprocessed by tools/model_pack into one file that is memory mapped at load
+// time. Every primitive's vertices are interleaved and its indices are in the GL index type, and
+// every texture is RGBA8 with its whole mip chain, so loading is glBufferData and glTexImage2D
+// straight from the mapping: no JSON parsing, no image decoding and no mipmap generation.
+//
+// Layout: PackHeader, then the PackModel, PackPrimitive, PackTexture and PackLevel tables, then the
+// blobs, each aligned to PACK_ALIGNMENT. Models are looked up by the path they were packed from.
+// Textures are stored once per image file, so models sharing an image share the PackTexture.
+
+const uint32_t PACK_VERSION = 1;
+const char PACK_MAGIC[4] = { 'M', 'P', 'A', 'K' };
+const size_t PACK_ALIGNMENT = 16;
+const size_t PACK_NAME_LENGTH = 256;
+
+// GL_UNSIGNED_SHORT and GL_UNSIGNED_INT, spelled out so the packer does not need GL
+const uint32_t PACK_UNSIGNED_SHORT = 0x1403;
+const uint32_t PACK_UNSIGNED_INT = 0x1405;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(PackHeader), catches a build with other struct packing
+    uint32_t modelCount;
+    uint32_t primitiveCount;
+    uint32_t textureCount;
+    uint32_t levelCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+};
+
+struct PackModel {
+    char name[PACK_NAME_LENGTH];    // Source path, zero terminated
+    uint32_t firstPrimitive;
+    uint32_t primitiveCount;
+};
+
+// Vertices are PackVertex; indices are PACK_UNSIGNED_SHORT or PACK_UNSIGNED_INT
+struct PackPrimitive {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;
+    int32_t texture;        // Base color, -1 if the material has none
+};
+
+struct PackTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t firstLevel;
+    uint32_t levelCount;    // Down to 1x1
+};
+
+struct PackLevel {
+    uint64_t offset;        // width * height RGBA8 texels
+    uint32_t width;
+    uint32_t height;
+};
+
+// Same attribute order and types as the glTF models: position, normal, texture coordinates
+struct PackVertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+// Read-only view of a mapped pack. The pointers it returns stay valid until close.
+class ModelPack {
+public:
+    // Maps path and checks the header and every table entry against the file size.
+    // Returns false if the file is missing or invalid.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // nullptr if name was not packed
+    const PackModel* findModel(const std::string& name) const;
+
+    const PackPrimitive& getPrimitive(uint32_t index) const { return primitives[index]; }
+    const PackTexture& getTexture(uint32_t index) const { return textures[index]; }
+    const PackLevel& getLevel(uint32_t index) const { return levels[index]; }
+    uint32_t getTextureCount() const { return header ? header->textureCount : 0; }
+
+    const void* at(uint64_t offset) const { return file.data() + offset; }
+    size_t getBytes() const { return file.size(); }
+
+private:
+    MappedFile file;
+    const PackHeader* header = nullptr;
+    const PackModel* models = nullptr;
+    const PackPrimitive* primitives = nullptr;
+    const PackTexture* textures = nullptr;
+    const PackLevel* levels = nullptr;
+
+    bool validate() const;
+};
+
+#endif
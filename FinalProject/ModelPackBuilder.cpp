@@ -0,0 +1,181 @@
+#include "ModelPackBuilder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+void PackBuilder::addBlob(std::vector<unsigned char> data, uint64_t& offset) {
+    offset = blobBytes;
+    blobBytes += (data.size() + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+    blobs.push_back(std::move(data));
+}
+
+bool beginPackModel(PackBuilder& pack, const std::string& name) {
+    if (name.size() >= PACK_NAME_LENGTH) return false;
+
+    PackModel model;
+    std::memset(&model, 0, sizeof(model));
+    std::strncpy(model.name, name.c_str(), PACK_NAME_LENGTH - 1);
+    model.firstPrimitive = static_cast<uint32_t>(pack.primitives.size());
+    pack.models.push_back(model);
+    return true;
+}
+
+bool addPackPrimitive(PackBuilder& pack, const std::vector<PackVertex>& vertices, const std::vector<uint32_t>& indices,
+                      uint32_t indexType, int texture) {
+    const bool shortIndices = indexType == PACK_UNSIGNED_SHORT;
+    const uint32_t maxIndex = shortIndices ? 0xFFFF : 0xFFFFFFFF;
+    const size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    std::vector<unsigned char> indexBlob(indices.size() * indexSize);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t index = indices[i];
+        if (index >= vertices.size() || index > maxIndex) return false;
+        if (shortIndices) {
+            uint16_t value = static_cast<uint16_t>(index);
+            std::memcpy(&indexBlob[i * indexSize], &value, indexSize);
+        } else {
+            std::memcpy(&indexBlob[i * indexSize], &index, indexSize);
+        }
+    }
+
+    std::vector<unsigned char> vertexBlob(vertices.size() * sizeof(PackVertex));
+    if (!vertices.empty()) std::memcpy(vertexBlob.data(), vertices.data(), vertexBlob.size());
+
+    PackPrimitive primitive;
+    std::memset(&primitive, 0, sizeof(primitive));
+    primitive.vertexCount = static_cast<uint32_t>(vertices.size());
+    primitive.indexCount = static_cast<uint32_t>(indices.size());
+    primitive.indexType = shortIndices ? PACK_UNSIGNED_SHORT : PACK_UNSIGNED_INT;
+    primitive.texture = texture;
+
+    pack.primitives.push_back(primitive);
+    pack.addBlob(std::move(vertexBlob), pack.primitives.back().vertexOffset);
+    pack.addBlob(std::move(indexBlob), pack.primitives.back().indexOffset);
+    pack.models.back().primitiveCount++;
+    return true;
+}
+
+// Level 0 and its mips as new levels and blobs; -1 if the image cannot be converted
+static int addMipChain(PackBuilder& pack, int width, int height, int components, const unsigned char* pixels) {
+    if (width <= 0 || height <= 0 || components < 1 || components > 4) return -1;
+
+    std::vector<unsigned char> texels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        const unsigned char* source = &pixels[i * components];
+        unsigned char* texel = &texels[i * 4];
+        texel[0] = source[0];
+        texel[1] = components >= 3 ? source[1] : source[0];
+        texel[2] = components >= 3 ? source[2] : source[0];
+        texel[3] = components == 4 ? source[3] : (components == 2 ? source[1] : 255);
+    }
+
+    PackTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.firstLevel = static_cast<uint32_t>(pack.levels.size());
+    texture.levelCount = 0;
+
+    while (true) {
+        PackLevel level;
+        level.width = width;
+        level.height = height;
+        pack.levels.push_back(level);
+        texture.levelCount++;
+        if (width == 1 && height == 1) {
+            pack.addBlob(std::move(texels), pack.levels.back().offset);
+            break;
+        }
+
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+        std::vector<unsigned char> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        for (int y = 0; y < nextHeight; ++y) {
+            int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for (int x = 0; x < nextWidth; ++x) {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for (int c = 0; c < 4; ++c) {
+                    int sum = texels[(static_cast<size_t>(y0) * width + x0) * 4 + c]
+                            + texels[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                            + texels[(static_cast<size_t>(y1) * width + x0) * 4 + c]
+                            + texels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                    next[(static_cast<size_t>(y) * nextWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+
+        pack.addBlob(std::move(texels), pack.levels.back().offset);
+        texels.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    pack.textures.push_back(texture);
+    return static_cast<int>(pack.textures.size()) - 1;
+}
+
+int addPackTexture(PackBuilder& pack, const std::string& key, int width, int height, int components,
+                   const unsigned char* pixels) {
+    auto known = pack.textureIndices.find(key);
+    if (known != pack.textureIndices.end()) return known->second;
+
+    int index = addMipChain(pack, width, height, components, pixels);
+    pack.textureIndices[key] = index;
+    return index;
+}
+
+bool writePack(PackBuilder& pack, const std::string& path) {
+    uint64_t tableEnd = sizeof(PackHeader)
+                      + pack.models.size() * sizeof(PackModel)
+                      + pack.primitives.size() * sizeof(PackPrimitive)
+                      + pack.textures.size() * sizeof(PackTexture)
+                      + pack.levels.size() * sizeof(PackLevel);
+    uint64_t blobStart = (tableEnd + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+
+    // Blob offsets become file offsets
+    for (PackPrimitive& primitive : pack.primitives) {
+        primitive.vertexOffset += blobStart;
+        primitive.indexOffset += blobStart;
+    }
+    for (PackLevel& level : pack.levels) level.offset += blobStart;
+
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.headerSize = sizeof(PackHeader);
+    header.modelCount = static_cast<uint32_t>(pack.models.size());
+    header.primitiveCount = static_cast<uint32_t>(pack.primitives.size());
+    header.textureCount = static_cast<uint32_t>(pack.textures.size());
+    header.levelCount = static_cast<uint32_t>(pack.levels.size());
+    header.fileSize = blobStart + pack.blobBytes;
+
+    // Written next to the target and renamed, so a running game never maps a half-written pack
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+    const char zeros[PACK_ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(pack.models.data()), pack.models.size() * sizeof(PackModel));
+    out.write(reinterpret_cast<const char*>(pack.primitives.data()), pack.primitives.size() * sizeof(PackPrimitive));
+    out.write(reinterpret_cast<const char*>(pack.textures.data()), pack.textures.size() * sizeof(PackTexture));
+    out.write(reinterpret_cast<const char*>(pack.levels.data()), pack.levels.size() * sizeof(PackLevel));
+    out.write(zeros, blobStart - tableEnd);
+    for (const std::vector<unsigned char>& blob : pack.blobs) {
+        out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+        out.write(zeros, (PACK_ALIGNMENT - blob.size() % PACK_ALIGNMENT) % PACK_ALIGNMENT);
+    }
+    out.close();
+    if (!out) {
+        std::fprintf(stderr, "Failed to write %s\n", temporary.c_str());
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::fprintf(stderr, "Failed to replace %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
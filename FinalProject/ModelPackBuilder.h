@@ -0,0 +1,47 @@
+#ifndef MODEL_PACK_BUILDER_H
+#define MODEL_PACK_BUILDER_H
+
+#include "ModelPack.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Collects models, primitives and textures in memory and writes them as a ModelPack file.
+// tools/model_pack fills it from glTF files; it needs neither GL nor tinygltf, so
+// model_pack_test fills it directly.
+struct PackBuilder {
+    std::vector<PackModel> models;
+    std::vector<PackPrimitive> primitives;
+    std::vector<PackTexture> textures;
+    std::vector<PackLevel> levels;
+
+    // Blob contents in file order; offsets are relative to the first blob until writePack
+    std::vector<std::vector<unsigned char>> blobs;
+    uint64_t blobBytes = 0;
+
+    // Image file or embedded image -> texture index, so models sharing an image store it once
+    std::map<std::string, int> textureIndices;
+
+    void addBlob(std::vector<unsigned char> data, uint64_t& offset);
+};
+
+// Starts a model stored under name; the primitives added next belong to it.
+// Returns false if the name does not fit in PackModel::name.
+bool beginPackModel(PackBuilder& pack, const std::string& name);
+
+// Appends a primitive to the last model, with indices stored as indexType (PACK_UNSIGNED_SHORT or
+// PACK_UNSIGNED_INT) and texture as returned by addPackTexture. Returns false if an index is out of
+// range for the vertices or for indexType.
+bool addPackPrimitive(PackBuilder& pack, const std::vector<PackVertex>& vertices, const std::vector<uint32_t>& indices,
+                      uint32_t indexType, int texture);
+
+// Texture index for the image known as key, adding the image on first use: level 0 is the
+// 8-bit pixels with 1 to 4 components as RGBA8, and each next level averages 2x2 texels of the
+// previous one, like glGenerateMipmap, down to 1x1. Returns -1 for an unsupported image.
+int addPackTexture(PackBuilder& pack, const std::string& key, int width, int height, int components,
+                   const unsigned char* pixels);
+
+// Writes the pack next to path and renames it into place. Returns false on I/O errors.
+bool writePack(PackBuilder& pack, const std::string& path);
+
+#endif
@@ -0,0 +1,99 @@
+#include "ShadowMap.h"
+
+#include <iostream>
+#include <vector>
+#include <stb_image_write.h>
+#include <render/shader.h>
+
+void ShadowMap::initialize(int width, int height, GLuint sharedDepthProgramID) {
+    this->width = width;
+    this->height = height;
+
+    // Create a fbo
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    // Create a depth texture
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Failed to create framebuffer" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    depthProgramID = sharedDepthProgramID;
+    ownsDepthProgram = (depthProgramID == 0);
+    if (ownsDepthProgram) {
+        depthProgramID = LoadShadersFromFile("../FinalProject/shader/depth.vert", "../FinalProject/shader/depth.frag");
+        if (depthProgramID == 0) std::cerr << "Failed to load depth shaders." << std::endl;
+    }
+
+    lightSpaceMatrixID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
+    modelMatrixID = glGetUniformLocation(depthProgramID, "Model");
+
+    dirty = true;
+}
+
+bool ShadowMap::needsUpdate(const glm::mat4& lightSpaceMatrix) const {
+    return dirty || lightSpaceMatrix != renderedLightSpaceMatrix;
+}
+
+void ShadowMap::begin(const glm::mat4& lightSpaceMatrix) {
+    renderedLightSpaceMatrix = lightSpaceMatrix;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(depthProgramID);
+    glUniformMatrix4fv(lightSpaceMatrixID, 1, GL_FALSE, &renderedLightSpaceMatrix[0][0]);
+    setModelMatrix(glm::mat4(1.0f));
+}
+
+void ShadowMap::setModelMatrix(const glm::mat4& model) const {
+    glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &model[0][0]);
+}
+
+void ShadowMap::end() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    dirty = false;
+
+    if (saveDepth) {
+        saveDepthTexture(debugFilename);
+        std::cout << "Depth texture saved to " << debugFilename << std::endl;
+        saveDepth = false;
+    }
+}
+
+void ShadowMap::saveDepthTexture(const std::string& filename) const {
+    int channels = 3;
+
+    std::vector<float> depth(width * height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::vector<unsigned char> img(width * height * 3);
+    for (int i = 0; i < width * height; ++i) img[3*i] = img[3*i+1] = img[3*i+2] = depth[i] * 255;
+
+    stbi_write_png(filename.c_str(), width, height, channels, img.data(), width * channels);
+}
+
+void ShadowMap::cleanup() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &depthTexture);
+    if (ownsDepthProgram) glDeleteProgram(depthProgramID);
+}
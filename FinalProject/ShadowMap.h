@@ -0,0 +1,56 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include "glad/gl.h"
+
+// One depth map for the whole scene. Every shadow caster draws into it once per update,
+// and every receiver samples the same texture. CascadedShadowMap uses one per cascade.
+class ShadowMap {
+public:
+    // Pass a depth program to share one between several maps; otherwise the map loads its own
+    void initialize(int width = 2048, int height = 1536, GLuint sharedDepthProgramID = 0);
+
+    // True when the light moved or a caster changed since the last update
+    bool needsUpdate(const glm::mat4& lightSpaceMatrix) const;
+
+    // Force a re-render on the next frame, e.g. when terrain streamed in or something animated
+    void invalidate() { dirty = true; }
+
+    // Bind the shadow framebuffer and the shared depth program; casters then call
+    // setModelMatrix and issue their draws with positions at attribute 0.
+    void begin(const glm::mat4& lightSpaceMatrix);
+    void setModelMatrix(const glm::mat4& model) const;
+    void end();
+
+    GLuint getDepthTexture() const { return depthTexture; }
+    GLuint getDepthProgramID() const { return depthProgramID; }
+    const glm::mat4& getLightSpaceMatrix() const { return renderedLightSpaceMatrix; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Write the depth map to a png on the next end(), for debugging
+    bool saveDepth = false;
+    std::string debugFilename = "depth_light.png";
+
+    void cleanup();
+
+private:
+    int width = 0;
+    int height = 0;
+
+    GLuint fbo = 0;
+    GLuint depthTexture = 0;
+    GLuint depthProgramID = 0;
+    bool ownsDepthProgram = false;
+    GLuint lightSpaceMatrixID = 0;
+    GLuint modelMatrixID = 0;
+
+    glm::mat4 renderedLightSpaceMatrix = glm::mat4(0.0f);
+    bool dirty = true;
+
+    void saveDepthTexture(const std::string& filename) const;
+};
+
+#endif
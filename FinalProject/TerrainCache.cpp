@@ -0,0 +1,335 @@
+#include "TerrainCache.h"
+#include "Fnv1a.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Bump whenever the file layout or the generator output changes
+const uint32_t CACHE_VERSION = 3;
+const char CACHE_MAGIC[4] = { 'T', 'C', 'H', 'K' };
+
+// Write the index after this many new files, so a crash loses little LRU history
+const int INDEX_WRITE_INTERVAL = 16;
+
+struct ChunkFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t paramsHash;
+    int32_t centerX;
+    int32_t centerZ;
+    int32_t width;
+    int32_t depth;
+    float originX;
+    float originZ;
+    float minHeight;
+    float maxHeight;
+    float lodErrors[TERRAIN_LOD_LEVELS];
+    uint32_t vertexCount;
+    uint32_t headerSize;     // Catches layout changes the version bump missed
+    uint64_t checksum;       // Of the vertex bytes that follow the header
+};
+
+// Everything except the chunk position, so one hash covers a whole generator configuration
+uint64_t paramsHash(const TerrainCacheKey& key) {
+    Fnv1a fnv;
+    fnv.add(CACHE_VERSION);
+    fnv.add(static_cast<uint32_t>(sizeof(TerrainVertex)));
+    fnv.add(TERRAIN_LOD_STEPS, sizeof(TERRAIN_LOD_STEPS));
+    fnv.add(key.width);
+    fnv.add(key.depth);
+    fnv.add(key.maxHeight);
+    fnv.add(key.noiseHash);
+    return fnv.hash;
+}
+
+bool makeDirectory(const std::string& directory) {
+#ifdef _WIN32
+    int result = _mkdir(directory.c_str());
+#else
+    int result = mkdir(directory.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
+
+bool fileExists(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return file.good();
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+struct DirectoryFile {
+    std::string name;
+    size_t bytes;
+};
+
+// Regular files directly in directory
+std::vector<DirectoryFile> listFiles(const std::string& directory) {
+    std::vector<DirectoryFile> files;
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE) return files;
+    do {
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        size_t bytes = (static_cast<size_t>(found.nFileSizeHigh) << 32) | found.nFileSizeLow;
+        files.push_back(DirectoryFile{ found.cFileName, bytes });
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return files;
+    while (dirent* entry = readdir(dir)) {
+        struct stat info;
+        std::string name = entry->d_name;
+        if (stat((directory + "/" + name).c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+        files.push_back(DirectoryFile{ name, static_cast<size_t>(info.st_size) });
+    }
+    closedir(dir);
+#endif
+    return files;
+}
+
+} // namespace
+
+bool TerrainCache::initialize(const std::string& directory, size_t maxBytes) {
+    this->directory = directory;
+    this->maxBytes = maxBytes;
+
+    enabled = makeDirectory(directory);
+    if (!enabled) {
+        std::cerr << "Terrain cache disabled: cannot create " << directory << std::endl;
+        return false;
+    }
+
+    // Rebuild the LRU order from the last run; files that have since disappeared are skipped
+    std::ifstream index(path("index.txt"));
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        Entry entry;
+        if (!(fields >> entry.name >> entry.bytes)) continue;
+        if (entries.count(entry.name) || !fileExists(path(entry.name))) continue;
+
+        lru.push_back(entry);
+        entries[entry.name] = std::prev(lru.end());
+        stats.bytesOnDisk += entry.bytes;
+    }
+
+    // Chunks stored after the last index write of a run that crashed are not in the index. They
+    // go to the old end so they count against maxBytes and are evicted first; temporary files of
+    // interrupted writes are deleted.
+    for (const DirectoryFile& file : listFiles(directory)) {
+        if (file.name.find(".chunk.tmp") != std::string::npos) {
+            std::remove(path(file.name).c_str());
+            continue;
+        }
+        if (!endsWith(file.name, ".chunk") || entries.count(file.name)) continue;
+
+        lru.push_back(Entry{ file.name, file.bytes });
+        entries[file.name] = std::prev(lru.end());
+        stats.bytesOnDisk += file.bytes;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    evict();
+    return true;
+}
+
+std::string TerrainCache::fileName(const TerrainCacheKey& key) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx_%d_%d.chunk",
+             static_cast<unsigned long long>(paramsHash(key)), key.centerX, key.centerZ);
+    return name;
+}
+
+bool TerrainCache::load(const TerrainCacheKey& key, TerrainData& data) {
+    if (!enabled) return false;
+
+    const std::string name = fileName(key);
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(path(name))) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.misses++;
+        return false;
+    }
+
+    const size_t vertexCount = static_cast<size_t>(key.width + 1) * (key.depth + 1);
+    const size_t expectedSize = sizeof(ChunkFileHeader) + vertexCount * sizeof(TerrainVertex);
+
+    ChunkFileHeader header;
+    bool valid = file->size() == expectedSize;
+    if (valid) {
+        std::memcpy(&header, file->data(), sizeof(header));
+        valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+             && header.version == CACHE_VERSION
+             && header.headerSize == sizeof(ChunkFileHeader)
+             && header.paramsHash == paramsHash(key)
+             && header.centerX == key.centerX && header.centerZ == key.centerZ
+             && header.width == key.width && header.depth == key.depth
+             && header.vertexCount == vertexCount;
+    }
+    if (valid) {
+        Fnv1a checksum;
+        checksum.add(file->data() + sizeof(ChunkFileHeader), vertexCount * sizeof(TerrainVertex));
+        valid = checksum.hash == header.checksum;
+    }
+
+    if (!valid) {
+        std::cerr << "Discarding invalid terrain cache file " << name << std::endl;
+        file->close();
+        std::lock_guard<std::mutex> lock(mutex);
+        forget(name);
+        std::remove(path(name).c_str());
+        stats.misses++;
+        return false;
+    }
+
+    // The vertices stay in the mapping until updateBuffers has uploaded them
+    data.vertices.clear();
+    data.mappedVertices = reinterpret_cast<const TerrainVertex*>(file->data() + sizeof(ChunkFileHeader));
+    data.mappedVertexCount = vertexCount;
+    data.mappedFile = file;
+    data.originX = header.originX;
+    data.originZ = header.originZ;
+    data.minHeight = header.minHeight;
+    data.maxHeight = header.maxHeight;
+    std::copy(header.lodErrors, header.lodErrors + TERRAIN_LOD_LEVELS, data.lodErrors);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    touch(name, expectedSize);
+    stats.hits++;
+    return true;
+}
+
+void TerrainCache::store(const TerrainCacheKey& key, const TerrainData& data) {
+    if (!enabled) return;
+
+    const std::string name = fileName(key);
+    const size_t payloadSize = data.vertexCount() * sizeof(TerrainVertex);
+
+    ChunkFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.paramsHash = paramsHash(key);
+    header.centerX = key.centerX;
+    header.centerZ = key.centerZ;
+    header.width = key.width;
+    header.depth = key.depth;
+    header.originX = data.originX;
+    header.originZ = data.originZ;
+    header.minHeight = data.minHeight;
+    header.maxHeight = data.maxHeight;
+    std::copy(data.lodErrors, data.lodErrors + TERRAIN_LOD_LEVELS, header.lodErrors);
+    header.vertexCount = static_cast<uint32_t>(data.vertexCount());
+    header.headerSize = sizeof(ChunkFileHeader);
+
+    Fnv1a checksum;
+    checksum.add(data.vertexData(), payloadSize);
+    header.checksum = checksum.hash;
+
+    std::string tempPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tempPath = path(name) + ".tmp" + std::to_string(tempCounter++);
+    }
+
+    // Write to a temporary file and rename it, so readers never map a half-written chunk
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write terrain cache file " << tempPath << std::endl;
+        return;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                && fwrite(data.vertexData(), payloadSize, 1, file) == 1;
+    written = fclose(file) == 0 && written;
+
+    const std::string finalPath = path(name);
+    if (written && std::rename(tempPath.c_str(), finalPath.c_str()) != 0) {
+        // Windows does not replace existing files on rename
+        std::remove(finalPath.c_str());
+        written = std::rename(tempPath.c_str(), finalPath.c_str()) == 0;
+    }
+    if (!written) {
+        std::cerr << "Failed to write terrain cache file " << finalPath << std::endl;
+        std::remove(tempPath.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    touch(name, sizeof(header) + payloadSize);
+    evict();
+    if (++storesSinceIndexWrite >= INDEX_WRITE_INTERVAL) {
+        writeIndex();
+        storesSinceIndexWrite = 0;
+    }
+}
+
+void TerrainCache::touch(const std::string& name, size_t bytes) {
+    forget(name);
+    lru.push_front(Entry{ name, bytes });
+    entries[name] = lru.begin();
+    stats.bytesOnDisk += bytes;
+}
+
+void TerrainCache::forget(const std::string& name) {
+    auto it = entries.find(name);
+    if (it == entries.end()) return;
+
+    stats.bytesOnDisk -= it->second->bytes;
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+void TerrainCache::evict() {
+    // Always keep the newest file, even if it alone is over budget
+    while (stats.bytesOnDisk > maxBytes && lru.size() > 1) {
+        const Entry& oldest = lru.back();
+        std::remove(path(oldest.name).c_str());
+        stats.bytesOnDisk -= oldest.bytes;
+        stats.evictions++;
+        entries.erase(oldest.name);
+        lru.pop_back();
+    }
+}
+
+void TerrainCache::writeIndex() const {
+    std::ofstream index(path("index.txt"), std::ios::trunc);
+    for (const Entry& entry : lru) {
+        index << entry.name << " " << entry.bytes << "\n";
+    }
+}
+
+TerrainCacheStats TerrainCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void TerrainCache::cleanup() {
+    if (!enabled) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    writeIndex();
+}
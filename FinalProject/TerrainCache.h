@@ -0,0 +1,75 @@
+#ifndef TERRAIN_CACHE_H
+#define TERRAIN_CACHE_H
+
+#include "terrain.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Everything a generated chunk depends on. Chunks are keyed by their world-space center,
+// which maps one to one to TerrainManager's ChunkPosition.
+struct TerrainCacheKey {
+    int centerX = 0;
+    int centerZ = 0;
+    int width = 0;
+    int depth = 0;
+    float maxHeight = 0.0f;
+    uint64_t noiseHash = 0;    // TerrainNoiseGraph::getHash, covers the generator and the seed
+};
+
+struct TerrainCacheStats {
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;     // no file, or a file that failed validation
+    unsigned long long evictions = 0;
+    size_t bytesOnDisk = 0;
+};
+
+// Generated chunks saved as binary files, one per chunk, so revisits and restarts skip noise
+// generation. Each file has a versioned header that repeats the key and a checksum of the vertices;
+// loads map the file and hand the vertices to the upload path without copying them.
+// The least recently used files are deleted once the directory grows past maxBytes.
+// load and store are called from JobSystem workers and may run concurrently.
+class TerrainCache {
+public:
+    bool initialize(const std::string& directory, size_t maxBytes);
+
+    // Fills data and returns true on a valid hit
+    bool load(const TerrainCacheKey& key, TerrainData& data);
+    void store(const TerrainCacheKey& key, const TerrainData& data);
+
+    TerrainCacheStats getStats() const;
+
+    // Writes the LRU index so the next run knows the files and their order
+    void cleanup();
+
+private:
+    struct Entry {
+        std::string name;
+        size_t bytes;
+    };
+
+    std::string directory;
+    size_t maxBytes = 0;
+    bool enabled = false;
+
+    // Most recently used first
+    std::list<Entry> lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+    TerrainCacheStats stats;
+    int storesSinceIndexWrite = 0;
+    unsigned int tempCounter = 0;
+    mutable std::mutex mutex;
+
+    std::string fileName(const TerrainCacheKey& key) const;
+    std::string path(const std::string& name) const { return directory + "/" + name; }
+
+    // Callers hold mutex
+    void touch(const std::string& name, size_t bytes);
+    void forget(const std::string& name);
+    void evict();
+    void writeIndex() const;
+};
+
+#endif
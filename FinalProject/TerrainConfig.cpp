@@ -0,0 +1,123 @@
+#include "TerrainConfig.h"
+#include "TerrainNoiseGraph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string trim(const std::string& text) {
+    const char* spaces = " \t\r\n";
+    size_t first = text.find_first_not_of(spaces);
+    if (first == std::string::npos) return "";
+    size_t last = text.find_last_not_of(spaces);
+    return text.substr(first, last - first + 1);
+}
+
+template <typename T>
+bool parseValue(const std::string& text, T& value) {
+    std::istringstream stream(text);
+    T parsed;
+    if (!(stream >> parsed)) return false;
+    stream >> std::ws;
+    if (!stream.eof()) return false;
+    value = parsed;
+    return true;
+}
+
+} // namespace
+
+bool TerrainConfig::set(const std::string& key, const std::string& value) {
+    if (key == "chunk_size") return parseValue(value, chunkSize);
+    if (key == "max_height") return parseValue(value, maxHeight);
+    if (key == "view_distance") return parseValue(value, viewDistance);
+    if (key == "screen_error") return parseValue(value, maxScreenError);
+    if (key == "generator") return parseValue(value, generator);
+    if (key == "seed") return parseValue(value, seed);
+    if (key == "gpu_budget_mb") return parseValue(value, gpuBudgetMB);
+    if (key == "cpu_budget_mb") return parseValue(value, cpuBudgetMB);
+    return false;
+}
+
+bool TerrainConfig::loadFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos
+            || !set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)))) {
+            std::cerr << path << ":" << lineNumber << ": ignoring terrain option \"" << line << "\"" << std::endl;
+        }
+    }
+
+    validate();
+    return true;
+}
+
+void TerrainConfig::parseArguments(int argc, char** argv) {
+    // The file is the base, so options given next to it always win
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--config") == 0) {
+            if (!loadFile(argv[i + 1])) {
+                std::cerr << "Failed to read terrain config " << argv[i + 1] << std::endl;
+            }
+        }
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option.compare(0, 2, "--") != 0) continue;
+        if (option == "--config") {
+            ++i;
+            continue;
+        }
+
+        std::string key = option.substr(2);
+        std::replace(key.begin(), key.end(), '-', '_');
+        if (i + 1 >= argc || !set(key, argv[i + 1])) {
+            std::cerr << "Ignoring unknown or incomplete option " << option << std::endl;
+            continue;
+        }
+        ++i;
+    }
+
+    validate();
+}
+
+void TerrainConfig::validate() {
+    // Small chunks only fit the finest LOD steps; past 1024 cells a side a chunk passes 4 MB of vertices
+    chunkSize = std::min(std::max(chunkSize, 16), 1024);
+    maxHeight = std::min(std::max(maxHeight, 1), 1000);
+    viewDistance = std::min(std::max(viewDistance, 1), 32);
+    maxScreenError = std::min(std::max(maxScreenError, 0.25f), 64.0f);
+    gpuBudgetMB = std::min(std::max(gpuBudgetMB, 32), 65536);
+    cpuBudgetMB = std::min(std::max(cpuBudgetMB, 32), 65536);
+
+    if (!TerrainNoiseGraph::isPreset(generator)) {
+        std::cerr << "Unknown terrain generator \"" << generator << "\", using classic" << std::endl;
+        generator = "classic";
+    }
+
+    // Every chunk's vertices share one buffer addressed through gl_VertexID; keep it under 1 GB
+    const long long maxVertices = 1LL << 28;
+    const long long chunkVertices = static_cast<long long>(chunkSize + 1) * (chunkSize + 1);
+    while (viewDistance > 1 && chunkCount() * chunkVertices > maxVertices) --viewDistance;
+}
+
+std::string TerrainConfig::describe() const {
+    std::ostringstream stream;
+    stream << "chunk " << chunkSize << ", view " << viewDistance << " (" << chunkCount() << " chunks)"
+           << ", height " << maxHeight << ", error " << maxScreenError << "px"
+           << ", " << generator << " #" << seed;
+    return stream.str();
+}
@@ -0,0 +1,47 @@
+#ifndef TERRAIN_CONFIG_H
+#define TERRAIN_CONFIG_H
+
+#include <string>
+
+// Default location of the config file, relative to the build directory like the shaders
+const char* const TERRAIN_CONFIG_FILE = "../FinalProject/terrain.cfg";
+
+// Terrain settings that trade memory and frame time for quality. They can be read from a file
+// and from the command line at startup, and changed at runtime through TerrainManager::applyConfig.
+//
+// The file has one "key = value" per line, '#' starts a comment. The same keys are accepted on
+// the command line as --key value, with '-' in place of '_' (e.g. --view-distance 6).
+struct TerrainConfig {
+    int chunkSize = 500;         // World units and grid cells per chunk side
+    int maxHeight = 30;
+    int viewDistance = 4;        // Chunks loaded in each direction: 1 for a 3x3 grid, 3 for a 5x5 grid
+    float maxScreenError = 2.0f; // A chunk uses the coarsest LOD whose error stays under this many pixels
+    std::string generator = "classic"; // TerrainNoiseGraph preset
+    unsigned int seed = 0;       // Same seed and generator, same terrain on every machine
+
+    // Memory the terrain may hold, in MB. The GPU budget limits the view distance; under the CPU
+    // budget TerrainManager gives up prefetched chunks, then the heights of the farthest chunks.
+    int gpuBudgetMB = 512;
+    int cpuBudgetMB = 256;
+
+    int gridSize() const { return 2 * viewDistance + 1; }
+    int chunkCount() const { return gridSize() * gridSize(); }
+
+    // Sets one option by name, returns false for an unknown key or a malformed value
+    bool set(const std::string& key, const std::string& value);
+
+    // Missing files are not an error, the defaults are used then
+    bool loadFile(const std::string& path);
+
+    // Reads --config <file> first, then applies the remaining options on top of it
+    void parseArguments(int argc, char** argv);
+
+    // Clamp every option to a range the renderer supports
+    void validate();
+
+    // Short summary for the window title and logs,
+    // e.g. "chunk 500, view 4 (81 chunks), height 30, error 2px, classic #0"
+    std::string describe() const;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "TerrainGrid.h"
+
+#include <algorithm>
+#include <glm/glm.hpp>
+
+bool isTerrainLodUsable(int level, int width, int depth) {
+    int step = TERRAIN_LOD_STEPS[level];
+    return width % step == 0 && depth % step == 0 && 2 * step <= width && 2 * step <= depth;
+}
+
+int terrainStripQuads(int cacheSize) {
+    // With the first row primed, each row only adds its own vertices to the FIFO. When quad x reads
+    // vertex x of the previous row, the rest of that row and the new row's first x + 1 vertices came
+    // in after it: stripQuads + 1 entries whatever x is, which must stay below cacheSize.
+    return std::max(1, cacheSize - 2);
+}
+
+// Point on the band along one chunk edge: t runs along the edge, inset moves toward the center
+static GLuint edgeVertex(TerrainEdge edge, int t, int inset, int width, int depth) {
+    int x = 0, z = 0;
+    switch (edge) {
+        case EDGE_WEST:  x = inset;         z = t; break;
+        case EDGE_EAST:  x = width - inset; z = t; break;
+        case EDGE_SOUTH: x = t; z = inset;         break;
+        case EDGE_NORTH: x = t; z = depth - inset; break;
+        default: break;
+    }
+    return static_cast<GLuint>(z * (width + 1) + x);
+}
+
+// Triangulate the band between the chunk border, sampled every outerStep, and the first inner
+// row of the level, sampled every step. The four bands are trapezoids that meet on the corner
+// diagonals, so together they exactly fill the ring around the interior block.
+static void appendEdgeBand(std::vector<GLuint>& indices, TerrainEdge edge, int step, int outerStep,
+                           int width, int depth) {
+    const int length = (edge == EDGE_WEST || edge == EDGE_EAST) ? depth : width;
+
+    std::vector<int> outer;
+    for (int t = 0; t <= length; t += outerStep) outer.push_back(t);
+    std::vector<int> inner;
+    for (int t = step; t <= length - step; t += step) inner.push_back(t);
+
+    auto emit = [&](GLuint a, GLuint b, GLuint c) {
+        // Match the interior winding, which faces +y (counter-clockwise seen from above)
+        glm::vec3 pa(a % (width + 1), 0.0f, a / (width + 1));
+        glm::vec3 pb(b % (width + 1), 0.0f, b / (width + 1));
+        glm::vec3 pc(c % (width + 1), 0.0f, c / (width + 1));
+        if (glm::cross(pb - pa, pc - pa).y < 0.0f) std::swap(b, c);
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    };
+
+    // Zip the two rows together, always advancing along the one whose next vertex comes first
+    size_t i = 0, j = 0;
+    while (i + 1 < outer.size() || j + 1 < inner.size()) {
+        bool advanceOuter = j + 1 >= inner.size() || (i + 1 < outer.size() && outer[i + 1] <= inner[j + 1]);
+        if (advanceOuter) {
+            emit(edgeVertex(edge, outer[i], 0, width, depth),
+                 edgeVertex(edge, outer[i + 1], 0, width, depth),
+                 edgeVertex(edge, inner[j], step, width, depth));
+            ++i;
+        } else {
+            emit(edgeVertex(edge, outer[i], 0, width, depth),
+                 edgeVertex(edge, inner[j], step, width, depth),
+                 edgeVertex(edge, inner[j + 1], step, width, depth));
+            ++j;
+        }
+    }
+}
+
+// One level's interior block: quads from step to size - step on both axes, in strips
+static void appendInterior(std::vector<GLuint>& indices, int step, int stripQuads, int width, int depth) {
+    const int stripWidth = stripQuads * step;
+
+    for (int stripX = step; stripX < width - step; stripX += stripWidth) {
+        const int stripEnd = std::min(stripX + stripWidth, width - step);
+
+        // Load the strip's first row on its own with degenerate triangles, which the GPU drops
+        // before rasterizing. Otherwise the first row interleaves both of its rows in the FIFO, and
+        // every later row inherits that order and needs twice the cache.
+        const int firstRow = step * (width + 1);
+        for (int x = stripX; x <= stripEnd; x += 2 * step) {
+            GLuint a = firstRow + x;
+            GLuint b = firstRow + std::min(x + step, stripEnd);
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(b);
+        }
+
+        for (int z = step; z < depth - step; z += step) {
+            int currentRow = z * (width + 1);
+            int nextRow = (z + step) * (width + 1);
+
+            for (int x = stripX; x < stripEnd; x += step) {
+                GLuint topLeft = currentRow + x;
+                GLuint topRight = topLeft + step;
+                GLuint bottomLeft = nextRow + x;
+                GLuint bottomRight = bottomLeft + step;
+
+                indices.push_back(topLeft);
+                indices.push_back(bottomLeft);
+                indices.push_back(topRight);
+                indices.push_back(topRight);
+                indices.push_back(bottomLeft);
+                indices.push_back(bottomRight);
+            }
+        }
+    }
+}
+
+void buildTerrainGridIndices(int width, int depth, int stripQuads,
+                             std::vector<GLuint>& indices, TerrainGridLayout& layout) {
+    indices.clear();
+    indices.reserve(static_cast<size_t>(width) * depth * 8);
+    layout = TerrainGridLayout();
+
+    auto beginRange = [&](TerrainIndexRange& range) {
+        range.offset = indices.size() * sizeof(GLuint);
+    };
+    auto endRange = [&](TerrainIndexRange& range) {
+        range.count = static_cast<GLsizei>(indices.size() - range.offset / sizeof(GLuint));
+    };
+
+    for (int level = 0; level < TERRAIN_LOD_LEVELS && isTerrainLodUsable(level, width, depth); ++level) {
+        const int step = TERRAIN_LOD_STEPS[level];
+
+        beginRange(layout.interior[level]);
+        appendInterior(indices, step, stripQuads, width, depth);
+        endRange(layout.interior[level]);
+
+        // Stitched bands follow the next level's spacing on the border; the coarsest level never needs them
+        bool hasCoarser = level + 1 < TERRAIN_LOD_LEVELS && isTerrainLodUsable(level + 1, width, depth);
+        int coarserStep = hasCoarser ? TERRAIN_LOD_STEPS[level + 1] : step;
+
+        for (int edge = 0; edge < EDGE_COUNT; ++edge) {
+            for (int stitched = 0; stitched < 2; ++stitched) {
+                TerrainIndexRange& range = layout.edges[level][edge][stitched];
+                beginRange(range);
+                appendEdgeBand(indices, static_cast<TerrainEdge>(edge), step, stitched ? coarserStep : step, width, depth);
+                endRange(range);
+            }
+        }
+
+        layout.levelCount = level + 1;
+    }
+}
+
+VertexCacheStats analyzeVertexCache(const GLuint* indices, size_t indexCount, int cacheSize) {
+    VertexCacheStats stats;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        const GLuint* t = indices + i;
+        if (t[0] != t[1] && t[1] != t[2] && t[0] != t[2]) stats.triangles++;
+    }
+
+    GLuint maxIndex = 0;
+    for (size_t i = 0; i < indexCount; ++i) maxIndex = std::max(maxIndex, indices[i]);
+
+    // A vertex is cached while fewer than cacheSize misses happened since its own
+    std::vector<size_t> missedAt(indexCount ? maxIndex + 1 : 0, 0);
+    std::vector<bool> seen(missedAt.size(), false);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        GLuint v = indices[i];
+        if (!seen[v]) {
+            seen[v] = true;
+            stats.vertices++;
+        } else if (misses - missedAt[v] < static_cast<size_t>(cacheSize)) {
+            continue;
+        }
+        missedAt[v] = ++misses;
+    }
+    stats.transformed = misses;
+    return stats;
+}
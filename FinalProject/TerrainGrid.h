@@ -0,0 +1,70 @@
+#ifndef TERRAIN_GRID_H
+#define TERRAIN_GRID_H
+
+#include <cstddef>
+#include <vector>
+#include "glad/gl.h"
+
+// Geomipmapping: every chunk keeps its full-resolution vertices and draws a subset of them.
+// Level n uses every TERRAIN_LOD_STEPS[n]-th vertex; each step divides the next one so a
+// coarser level's vertices are always a subset of the finer level's.
+const int TERRAIN_LOD_LEVELS = 5;
+const int TERRAIN_LOD_STEPS[TERRAIN_LOD_LEVELS] = { 1, 2, 4, 20, 100 };
+
+// Chunk edges, named like the streaming directions in TerrainManager (north is +z, east is +x)
+enum TerrainEdge {
+    EDGE_WEST = 0,
+    EDGE_EAST,
+    EDGE_SOUTH,
+    EDGE_NORTH,
+    EDGE_COUNT
+};
+
+// Post-transform vertex cache the interior blocks are ordered for, in vertices. Hardware differs,
+// but a FIFO of this size is a common model, and strips sized for it degrade gracefully on larger caches.
+const int TERRAIN_VERTEX_CACHE_SIZE = 16;
+
+// A run of indices inside TerrainGridBuffers::indexBufferID
+struct TerrainIndexRange {
+    GLsizei count = 0;
+    size_t offset = 0; // In bytes, as passed to glDrawElements
+};
+
+// Where every level's pieces sit in the index buffer. A level is drawn as its interior block plus one
+// band per edge; each band comes in a plain variant and a stitched variant whose outer row
+// follows the next coarser level, so a chunk next to a coarser neighbour has no cracks.
+struct TerrainGridLayout {
+    // Number of levels of TERRAIN_LOD_STEPS usable at this resolution
+    int levelCount = 0;
+    TerrainIndexRange interior[TERRAIN_LOD_LEVELS];
+    TerrainIndexRange edges[TERRAIN_LOD_LEVELS][EDGE_COUNT][2]; // [level][edge][stitched]
+};
+
+// A level is usable when its step tiles the grid and leaves room for the edge bands
+bool isTerrainLodUsable(int level, int width, int depth);
+
+// Quads per strip that keep the previous row of a strip in a FIFO cache of cacheSize vertices
+int terrainStripQuads(int cacheSize);
+
+// Indices of every level of a (width + 1) x (depth + 1) vertex grid, back to back.
+// Interior blocks are walked in vertical strips of stripQuads quads, row by row within a strip,
+// so the shared row of vertices is still cached when the next row uses it. Each strip starts with
+// a few degenerate triangles that load its first row. A strip as wide as the grid is plain row order.
+void buildTerrainGridIndices(int width, int depth, int stripQuads,
+                             std::vector<GLuint>& indices, TerrainGridLayout& layout);
+
+// Vertex shader work for an index list on a simulated FIFO post-transform cache
+struct VertexCacheStats {
+    size_t triangles = 0;      // Not counting degenerate ones
+    size_t vertices = 0;       // Distinct vertices referenced
+    size_t transformed = 0;    // Cache misses, i.e. vertex shader invocations
+
+    // Average cache miss ratio: invocations per triangle, 0.5 at best for a large grid
+    float acmr() const { return triangles ? static_cast<float>(transformed) / triangles : 0.0f; }
+    // Average transform to vertex ratio: invocations per distinct vertex, 1.0 at best
+    float atvr() const { return vertices ? static_cast<float>(transformed) / vertices : 0.0f; }
+};
+
+VertexCacheStats analyzeVertexCache(const GLuint* indices, size_t indexCount, int cacheSize);
+
+#endif
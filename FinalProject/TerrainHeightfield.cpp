@@ -0,0 +1,55 @@
+#include "TerrainHeightfield.h"
+#include "terrain.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::shared_ptr<const TerrainHeightfield> TerrainHeightfield::create(const TerrainVertex* vertices, int width, int depth,
+                                                                     float originX, float originZ, float maxHeight) {
+    std::shared_ptr<TerrainHeightfield> field(new TerrainHeightfield());
+    field->width = width;
+    field->depth = depth;
+    field->originX = originX;
+    field->originZ = originZ;
+    field->maxHeight = maxHeight;
+
+    const size_t count = static_cast<size_t>(width + 1) * (depth + 1);
+    field->heights.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        field->heights[i] = vertices[i].height;
+    }
+    return field;
+}
+
+bool TerrainHeightfield::contains(float x, float z) const {
+    return x >= originX && x <= originX + width && z >= originZ && z <= originZ + depth;
+}
+
+float TerrainHeightfield::sample(float x, float z, glm::vec3* normal) const {
+    // The last row and column belong to the cell before them
+    float gx = std::min(std::max(x - originX, 0.0f), static_cast<float>(width));
+    float gz = std::min(std::max(z - originZ, 0.0f), static_cast<float>(depth));
+    int cx = std::min(static_cast<int>(gx), width - 1);
+    int cz = std::min(static_cast<int>(gz), depth - 1);
+    float fx = gx - cx;
+    float fz = gz - cz;
+
+    // Inverse of Terrain::packVertex
+    const float scale = 2.0f * maxHeight / 65535.0f;
+    const GLushort* row = &heights[static_cast<size_t>(cz) * (width + 1) + cx];
+    const float h00 = row[0] * scale - maxHeight;
+    const float h10 = row[1] * scale - maxHeight;
+    const float h01 = row[width + 1] * scale - maxHeight;
+    const float h11 = row[width + 2] * scale - maxHeight;
+
+    const float south = h00 + (h10 - h00) * fx;
+    const float north = h01 + (h11 - h01) * fx;
+
+    if (normal) {
+        // Partial derivatives of the bilinear patch; the grid spacing is one unit
+        float dx = (h10 - h00) + ((h11 - h01) - (h10 - h00)) * fz;
+        float dz = north - south;
+        *normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+    }
+    return south + (north - south) * fz;
+}
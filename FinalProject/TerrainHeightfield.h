@@ -0,0 +1,37 @@
+#ifndef TERRAIN_HEIGHTFIELD_H
+#define TERRAIN_HEIGHTFIELD_H
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "glad/gl.h"
+
+struct TerrainVertex;
+
+// CPU copy of one chunk's full-resolution heights for gameplay queries, kept in the packed 16-bit
+// form of TerrainVertex::height so it costs half of what the chunk takes on the GPU.
+// Immutable once built, so any thread may sample it.
+class TerrainHeightfield {
+public:
+    // Keeps the heights of a (width + 1) x (depth + 1) grid of vertices whose first one is at (originX, originZ)
+    static std::shared_ptr<const TerrainHeightfield> create(const TerrainVertex* vertices, int width, int depth,
+                                                            float originX, float originZ, float maxHeight);
+
+    bool contains(float x, float z) const;
+
+    size_t getBytes() const { return heights.size() * sizeof(GLushort); }
+
+    // Bilinear height at (x, z) and, unless normal is null, the normal of the bilinear patch there.
+    // Points outside are clamped to the border.
+    float sample(float x, float z, glm::vec3* normal = nullptr) const;
+
+private:
+    std::vector<GLushort> heights;
+    int width = 0;
+    int depth = 0;
+    float originX = 0.0f;
+    float originZ = 0.0f;
+    float maxHeight = 0.0f;
+};
+
+#endif
@@ -1,29 +1,69 @@
 #include "TerrainManager.h"
 #include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <set>
 
+std::shared_ptr<TerrainGridBuffers> TerrainManager::acquireGridBuffers(int width, int depth) {
+    std::pair<int, int> key(width, depth);
+    auto it = gridBuffers.find(key);
+    if (it == gridBuffers.end()) {
+        it = gridBuffers.insert(std::make_pair(key, Terrain::createGridBuffers(width, depth, static_cast<float>(config.maxHeight)))).first;
+    }
+    it->second->refCount++;
+    return it->second;
+}
+
+void TerrainManager::releaseGridBuffers(const std::shared_ptr<TerrainGridBuffers>& grid) {
+    if (!grid) return;
+
+    grid->refCount--;
+    if (grid->refCount <= 0) {
+        Terrain::deleteGridBuffers(*grid);
+        gridBuffers.erase(std::make_pair(grid->width, grid->depth));
+    }
+}
+
 // Helper function to create a unique_ptr for Chunk
-std::unique_ptr<Chunk> createChunk(const ChunkPosition& cp, GLuint programID, GLuint depthProgramID) {
+std::unique_ptr<Chunk> TerrainManager::createChunk(const ChunkPosition& cp) {
     std::unique_ptr<Chunk> chunk(new Chunk());
     chunk->position = cp;
 
     // Initialize Terrain within the Chunk
-    chunk->terrain.setProgramIDs(programID, depthProgramID);
+    chunk->terrain.setCache(&cache);
+    chunk->terrain.setNoiseGraph(noiseGraph);
+    chunk->terrain.setUploadRing(&uploadRing);
 
     // Initialize each chunk with its unique position
-    float posX = cp.x * CHUNK_SIZE;
-    float posZ = cp.z * CHUNK_SIZE;
-    chunk->terrain.initialize(CHUNK_SIZE, CHUNK_SIZE, MAX_HEIGHT, posX, posZ);
+    float posX = static_cast<float>(cp.x * config.chunkSize);
+    float posZ = static_cast<float>(cp.z * config.chunkSize);
+    chunk->terrain.initialize(acquireGridBuffers(config.chunkSize, config.chunkSize), &vertexPool,
+                              static_cast<float>(config.maxHeight), posX, posZ);
 
     return chunk;
 }
 
+void TerrainManager::destroyChunk(Chunk& chunk) {
+    std::shared_ptr<TerrainGridBuffers> grid = chunk.terrain.getGridBuffers();
+    chunk.terrain.cleanup();
+    releaseGridBuffers(grid);
+    setHeightfield(chunk.position, nullptr);
+}
+
+int TerrainManager::chunkSlot(const ChunkPosition& cp) const {
+    // Wrap negative coordinates too, so the slot only depends on the position modulo the grid
+    const int gridSize = config.gridSize();
+    int x = ((cp.x % gridSize) + gridSize) % gridSize;
+    int z = ((cp.z % gridSize) + gridSize) % gridSize;
+    return z * gridSize + x;
+}
+
 int TerrainManager::findChunkIndex(const ChunkPosition& cp) const {
-    for (size_t i = 0; i < chunks.size(); ++i) {
-        if (chunks[i]->position == cp) {
-            return static_cast<int>(i);
-        }
+    int slot = chunkSlot(cp);
+    if (slot < static_cast<int>(chunks.size()) && chunks[slot] && chunks[slot]->position == cp) {
+        return slot;
     }
     return -1;
 }
@@ -31,244 +71,886 @@ int TerrainManager::findChunkIndex(const ChunkPosition& cp) const {
 // Determine the chunk position based on camera coordinates
 ChunkPosition TerrainManager::getChunkPosition(const glm::vec3& pos) {
     return {
-        static_cast<int>(std::floor(pos.x / static_cast<float>(CHUNK_SIZE))),
-        static_cast<int>(std::floor(pos.z / static_cast<float>(CHUNK_SIZE)))
+        static_cast<int>(std::floor(pos.x / static_cast<float>(config.chunkSize))),
+        static_cast<int>(std::floor(pos.z / static_cast<float>(config.chunkSize)))
     };
 }
 
-bool TerrainManager::chucksToAddReplace(ChunkPosition newCenter,
-                                        std::vector<ChunkPosition>& chunksToAdd,
-                                        std::vector<ChunkPosition>& chunksToReplace)
-{
-    const int deltaX = newCenter.x - currentCenter.x;
-    const int deltaZ = newCenter.z - currentCenter.z;
-
+bool TerrainManager::rewrapChunks(ChunkPosition newCenter) {
     // If no change in center, nothing to do
-    if(deltaX == 0 && deltaZ == 0) return false;
-
-    // Handle movement along X axis
-    if (deltaX > 0) { // Moving East
-        for(int x = 1; x <= deltaX; ++x) {
-            for(int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; ++z) {
-                ChunkPosition cp = { newCenter.x + VIEW_DISTANCE, newCenter.z + z };
-                chunksToAdd.push_back(cp);
-            }
+    if (newCenter == currentCenter) return false;
+
+    currentCenter = newCenter;
+
+    // Every slot owns exactly one position in the new window: the one congruent to it modulo
+    // the grid size. Slots still holding a position from the old window get that one instead,
+    // which also covers jumps of more than one chunk.
+    const int minX = newCenter.x - config.viewDistance;
+    const int minZ = newCenter.z - config.viewDistance;
+    for (int i = 0; i < config.gridSize(); ++i) {
+        for (int j = 0; j < config.gridSize(); ++j) {
+            ChunkPosition newPos = { minX + j, minZ + i };
+            Chunk& chunk = *chunks[chunkSlot(newPos)];
+            if (chunk.position == newPos) continue;
+
+            // The chunk may still be generating for a position we just left
+            cancelGeneration(chunk.position);
+            setHeightfield(chunk.position, nullptr);
+
+            chunk.position = newPos;
+            queueGeneration(newPos);
         }
-        // Identify chunks to replace on the West side
-        for(int x = 0; x < deltaX; ++x) {
-            for(int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; ++z) {
-                ChunkPosition cp = { currentCenter.x - VIEW_DISTANCE + x, currentCenter.z + z };
-                chunksToReplace.push_back(cp);
-            }
+    }
+
+    sortQueuedChunks();
+    return true;
+}
+
+void TerrainManager::initialize(const glm::vec3& cameraPos, const TerrainConfig& initialConfig) {
+    config = initialConfig;
+    config.validate();
+    fitGpuBudget(config);
+    currentCenter = getChunkPosition(cameraPos);
+    lastCameraPos = cameraPos;
+    cameraVelocity = glm::vec2(0.0f);
+
+    createTerrainProgramID(programID);
+    createTerrainDepthProgramID(depthProgramID);
+
+    textureID = LoadTextureTileBox("../FinalProject/assets/textures/green_grass.jpg");
+
+    // The batch draws with the same programs every frame, so look the uniforms up once
+    mvpMatrixID = glGetUniformLocation(programID, "MVP");
+    modelMatrixID = glGetUniformLocation(programID, "Model");
+    textureSamplerID = glGetUniformLocation(programID, "textureSampler");
+    lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
+    lightDirectionID = glGetUniformLocation(programID, "lightDirection");
+    cameraPosID = glGetUniformLocation(programID, "cameraPos");
+    shadowUniforms = CascadedShadowMap::getUniformLocations(programID);
+    gridUniforms = getGridUniformLocations(programID);
+
+    depthLightSpaceMatrixID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
+    depthGridUniforms = getGridUniformLocations(depthProgramID);
+
+    cache.initialize(TERRAIN_CACHE_DIRECTORY, TERRAIN_CACHE_MAX_BYTES);
+    initializeUploadRing();
+    resetHeightSource();
+
+    // Load initial chunks within the view distance. They start as flat placeholders
+    // and are generated in the background, nearest first, so the first frame is not delayed.
+    rebuildChunkGrid(true);
+
+    submitQueuedGenerations();
+    updateLods(cameraPos);
+
+    std::cout << "Terrain: " << config.describe() << std::endl;
+}
+
+void TerrainManager::initializeUploadRing() {
+    // One slot per job that can be in flight, plus two so slots still being copied
+    // by the GPU do not hold back the next submissions
+    uploadRing.initialize(stagingSlotCount(), chunkVertexBytes(), TERRAIN_UPLOAD_BUDGET_BYTES);
+}
+
+int TerrainManager::stagingSlotCount() const {
+    return 2 * static_cast<int>(JobSystem::instance().getWorkerCount()) + 2;
+}
+
+void TerrainManager::initializeVertexPool() {
+    vertexPool.cleanup();
+
+    // The pool draws with the grid's index buffer, so it holds a reference of its own
+    releaseGridBuffers(poolGrid);
+    poolGrid = acquireGridBuffers(config.chunkSize, config.chunkSize);
+    vertexPool.initialize(config.chunkCount(), config.chunkSize, config.chunkSize, poolGrid->indexBufferID);
+}
+
+size_t TerrainManager::chunkVertexBytes() const {
+    return static_cast<size_t>(config.chunkSize + 1) * (config.chunkSize + 1) * sizeof(TerrainVertex);
+}
+
+void TerrainManager::rebuildChunkGrid(bool regenerate) {
+    std::vector<std::unique_ptr<Chunk>> oldChunks;
+    oldChunks.swap(chunks);
+    chunks.resize(config.chunkCount());
+
+    // Chunks still inside the window move to their slot for the new grid size, with their
+    // geometry; the rest are dropped. Distinct positions in one window never share a slot.
+    for (auto& chunk : oldChunks) {
+        if (!chunk) continue;
+
+        const ChunkPosition cp = chunk->position;
+        bool inside = std::abs(cp.x - currentCenter.x) <= config.viewDistance
+                   && std::abs(cp.z - currentCenter.z) <= config.viewDistance;
+        if (inside && !regenerate) {
+            chunks[chunkSlot(cp)] = std::move(chunk);
+            continue;
         }
+
+        cancelGeneration(cp);
+        destroyChunk(*chunk);
     }
-    else if (deltaX < 0) { // Moving West
-        for(int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; ++z) {
-            ChunkPosition cp = { newCenter.x - VIEW_DISTANCE, newCenter.z + z };
-            chunksToAdd.push_back(cp);
+
+    // One page per slot. Kept chunks hold on to their vertices, which the pool may move.
+    if (regenerate || vertexPool.getPageCount() == 0) {
+        initializeVertexPool();
+    } else if (vertexPool.getPageCount() != config.chunkCount()) {
+        std::vector<int> remap = vertexPool.resize(config.chunkCount());
+        for (auto& chunk : chunks) {
+            if (chunk && chunk->terrain.getPage() >= 0) chunk->terrain.setPage(remap[chunk->terrain.getPage()]);
         }
-        // Identify chunks to replace on the East side
-        for(int x = 0; x < -deltaX; ++x) {
-            for(int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; ++z) {
-                ChunkPosition cp = { currentCenter.x + VIEW_DISTANCE + x, currentCenter.z + z };
-                chunksToReplace.push_back(cp);
-            }
+    }
+
+    for (int x = -config.viewDistance; x <= config.viewDistance; ++x) {
+        for (int z = -config.viewDistance; z <= config.viewDistance; ++z) {
+            ChunkPosition cp = {currentCenter.x + x, currentCenter.z + z};
+
+            // Each chunk keeps its slot for good; moving only changes the position it holds
+            std::unique_ptr<Chunk>& slot = chunks[chunkSlot(cp)];
+            if (slot) continue;
+
+            slot = createChunk(cp);
+            queueGeneration(cp);
         }
     }
 
-    // Handle movement along Z axis
-    if (deltaZ > 0) { // Moving North
-        for(int z = 1; z <= deltaZ; ++z) {
-            for(int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; ++x) {
-                ChunkPosition cp = { newCenter.x + x, newCenter.z + VIEW_DISTANCE };
-                // Avoid duplicates if we also moved in X
-                bool add = true;
-                if (deltaX != 0) {
-                    for (auto & chunk : chunksToAdd) {
-                        if (chunk.x == cp.x && chunk.z == cp.z) {
-                            add = false;
-                            break;
-                        }
-                    }
-                }
-                if (add) chunksToAdd.push_back(cp);
-            }
+    sortQueuedChunks();
+}
+
+void TerrainManager::applyConfig(const TerrainConfig& newConfig, const glm::vec3& cameraPos) {
+    TerrainConfig validated = newConfig;
+    validated.validate();
+    fitGpuBudget(validated);
+
+    const bool geometryChanged = validated.chunkSize != config.chunkSize || validated.maxHeight != config.maxHeight
+                              || validated.generator != config.generator || validated.seed != config.seed;
+    const bool windowChanged = validated.viewDistance != config.viewDistance;
+
+    if (geometryChanged) {
+        // Every chunk is regenerated for the new size, and the staging slots are resized
+        // for it, so the old jobs have to be done writing into them first
+        finishGenerations();
+        uploadRing.cleanup();
+    }
+
+    config = validated;
+
+    if (geometryChanged || windowChanged) {
+        if (geometryChanged) {
+            initializeUploadRing();
+            resetHeightSource();
         }
-        // Identify chunks to replace on the South side
-        for(int z = 0; z < deltaZ; ++z) {
-            for(int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; ++x) {
-                ChunkPosition cp = { currentCenter.x + x, currentCenter.z - VIEW_DISTANCE + z };
-                bool replace = true;
-                if (deltaX != 0) {
-                    for (auto & chunk : chunksToReplace) {
-                        if (chunk.x == cp.x && chunk.z == cp.z) {
-                            replace = false;
-                            break;
-                        }
-                    }
-                }
-                if (replace) chunksToReplace.push_back(cp);
-            }
+
+        // A view distance change keeps every chunk that is still in range
+        currentCenter = getChunkPosition(cameraPos);
+        rebuildChunkGrid(geometryChanged);
+        submitQueuedGenerations();
+    }
+    updateLods(cameraPos);
+
+    TerrainMemoryStats memory = getMemoryStats();
+    std::cout << "Terrain: " << config.describe() << ", " << memory.gpuBytes() / (1024.0 * 1024.0) << " MB on the GPU" << std::endl;
+}
+
+TerrainMemoryStats TerrainManager::getMemoryStats() const {
+    TerrainMemoryStats stats;
+    stats.vertexBytes = vertexPool.getCapacityBytes();
+    for (auto& entry : gridBuffers) {
+        stats.gridBytes += entry.second->gpuBytes;
+    }
+    stats.stagingBytes = uploadRing.getCapacityBytes();
+
+    stats.heightfieldBytes = heightfieldBytes;
+    for (const auto& entry : prefetchedChunks) {
+        stats.prefetchBytes += prefetchedChunkBytes(entry.second);
+    }
+    stats.jobBytes = (generationFutures.size() + prefetchFutures.size()) * jobWorkingBytes();
+
+    stats.gpuBudget = static_cast<size_t>(config.gpuBudgetMB) * 1024 * 1024;
+    stats.cpuBudget = cpuBudgetBytes();
+    return stats;
+}
+
+size_t TerrainManager::estimateGpuBytes(const TerrainConfig& newConfig) const {
+    const size_t cells = static_cast<size_t>(newConfig.chunkSize) * newConfig.chunkSize;
+    const size_t chunkBytes = static_cast<size_t>(newConfig.chunkSize + 1) * (newConfig.chunkSize + 1) * sizeof(TerrainVertex);
+
+    // A page per slot, the staging slots and the placeholder tile, plus the index buffer: six indices
+    // per cell at full resolution and under a third more for the coarser levels and edge bands
+    const size_t indexBytes = cells * 6 * sizeof(GLuint) * 4 / 3;
+    return (newConfig.chunkCount() + stagingSlotCount() + 1) * chunkBytes + indexBytes;
+}
+
+void TerrainManager::fitGpuBudget(TerrainConfig& newConfig) const {
+    const size_t budget = static_cast<size_t>(newConfig.gpuBudgetMB) * 1024 * 1024;
+    const int requested = newConfig.viewDistance;
+    while (newConfig.viewDistance > 1 && estimateGpuBytes(newConfig) > budget) --newConfig.viewDistance;
+
+    if (newConfig.viewDistance != requested) {
+        std::cerr << "Terrain: view distance " << requested << " does not fit the " << newConfig.gpuBudgetMB
+                  << " MB GPU budget, using " << newConfig.viewDistance << std::endl;
+    }
+}
+
+size_t TerrainManager::jobWorkingBytes() const {
+    // Heights with their apron as floats, the vertices, and the heightfield made from them
+    const size_t apron = static_cast<size_t>(config.chunkSize + 3) * (config.chunkSize + 3) * sizeof(float);
+    const size_t heights = static_cast<size_t>(config.chunkSize + 1) * (config.chunkSize + 1) * sizeof(GLushort);
+    return apron + chunkVertexBytes() + heights;
+}
+
+size_t TerrainManager::prefetchedChunkBytes(const TerrainData& data) const {
+    return data.vertexCount() * sizeof(TerrainVertex) + (data.heightfield ? data.heightfield->getBytes() : 0);
+}
+
+size_t TerrainManager::maxGenerationsInFlight() const {
+    // Running jobs may use up to half the CPU budget; a small budget streams slower rather than overshoot
+    const size_t byBudget = cpuBudgetBytes() / 2 / jobWorkingBytes();
+    const size_t perWorkers = 2 * static_cast<size_t>(JobSystem::instance().getWorkerCount());
+    return std::max(static_cast<size_t>(1), std::min(perWorkers, byBudget));
+}
+
+void TerrainManager::enforceCpuBudget(const glm::vec3& cameraPos) {
+    const size_t budget = cpuBudgetBytes();
+    size_t used = getMemoryStats().cpuBytes();
+    if (used <= budget) return;
+
+    auto distance2 = [&](const ChunkPosition& cp) {
+        float dx = cp.x * config.chunkSize - cameraPos.x;
+        float dz = cp.z * config.chunkSize - cameraPos.z;
+        return dx * dx + dz * dz;
+    };
+
+    // Speculative data is worth the least: it may never be needed and is only a regeneration away
+    while (used > budget && !prefetchedChunks.empty()) {
+        auto farthest = std::max_element(prefetchedChunks.begin(), prefetchedChunks.end(),
+            [&](const std::pair<const ChunkPosition, TerrainData>& a, const std::pair<const ChunkPosition, TerrainData>& b) {
+                return distance2(a.first) < distance2(b.first);
+            });
+        used -= prefetchedChunkBytes(farthest->second);
+        prefetchedChunks.erase(farthest);
+        prefetchStats.dropped++;
+    }
+    if (used <= budget) return;
+
+    // Then the heights of the farthest chunks; queries there fall back to evaluating the noise
+    std::lock_guard<std::mutex> lock(heightMutex);
+    std::vector<std::pair<float, ChunkPosition>> byDistance;
+    byDistance.reserve(heightfields.size());
+    for (const auto& entry : heightfields) {
+        byDistance.push_back(std::make_pair(distance2(entry.first), entry.first));
+    }
+    std::sort(byDistance.begin(), byDistance.end(),
+        [](const std::pair<float, ChunkPosition>& a, const std::pair<float, ChunkPosition>& b) { return a.first > b.first; });
+
+    for (size_t i = 0; i < byDistance.size() && used > budget; ++i) {
+        auto it = heightfields.find(byDistance[i].second);
+        const size_t bytes = it->second->getBytes();
+        used -= std::min(used, bytes);
+        heightfieldBytes -= bytes;
+        heightfields.erase(it);
+    }
+}
+
+void TerrainManager::queueGeneration(const ChunkPosition& cp) {
+    if (adoptPrefetch(cp)) return;
+    queuedChunks.push_back(cp);
+}
+
+bool TerrainManager::adoptPrefetch(const ChunkPosition& cp) {
+    auto ready = prefetchedChunks.find(cp);
+    if (ready != prefetchedChunks.end()) {
+        // Hand the data over as a job that is already done, so pollTerrainFutures uploads it
+        // under the frame budget like any other
+        std::promise<TerrainData> done;
+        done.set_value(std::move(ready->second));
+        prefetchedChunks.erase(ready);
+
+        PendingGeneration pending;
+        pending.cancelToken = makeCancelToken();
+        pending.future = done.get_future();
+        generationFutures[cp] = std::move(pending);
+        prefetchStats.ready++;
+        return true;
+    }
+
+    auto running = prefetchFutures.find(cp);
+    if (running != prefetchFutures.end()) {
+        generationFutures[cp] = std::move(running->second);
+        prefetchFutures.erase(running);
+        prefetchStats.running++;
+        return true;
+    }
+
+    return false;
+}
+
+size_t TerrainManager::maxPrefetchChunks() const {
+    // At least a full row of the window, so a straight move is always covered one chunk ahead,
+    // unless the CPU budget left after resident heights and running jobs has no room for it
+    const size_t wanted = std::max(static_cast<size_t>(config.gridSize()), TERRAIN_PREFETCH_MAX_BYTES / chunkVertexBytes());
+    const size_t used = heightfieldBytes + (generationFutures.size() + prefetchFutures.size()) * jobWorkingBytes();
+    const size_t available = cpuBudgetBytes() > used ? cpuBudgetBytes() - used : 0;
+    const size_t chunkBytes = chunkVertexBytes() + chunkVertexBytes() / 2;   // Vertices and heightfield
+    return std::min(wanted, available / chunkBytes);
+}
+
+void TerrainManager::trackCameraVelocity(const glm::vec3& cameraPos, float deltaTime) {
+    glm::vec2 moved(cameraPos.x - lastCameraPos.x, cameraPos.z - lastCameraPos.z);
+    lastCameraPos = cameraPos;
+    if (deltaTime <= 0.0f) return;
+
+    // Jumps to the light or back to the start are not motion to extrapolate
+    if (glm::length(moved) > config.chunkSize) {
+        cameraVelocity = glm::vec2(0.0f);
+        return;
+    }
+
+    float blend = 1.0f - std::exp(-deltaTime / TERRAIN_VELOCITY_SMOOTHING);
+    cameraVelocity += (moved / deltaTime - cameraVelocity) * blend;
+}
+
+void TerrainManager::updatePrefetch(const glm::vec3& cameraPos) {
+    for (auto it = prefetchFutures.begin(); it != prefetchFutures.end(); ) {
+        if (it->second.future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+            TerrainData data = it->second.future.get();
+            if (data.vertexCount() > 0) prefetchedChunks[it->first] = std::move(data);
+            it = prefetchFutures.erase(it);
+        } else {
+            ++it;
         }
     }
-    else if (deltaZ < 0) { // Moving South
-        for(int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; ++x) {
-            ChunkPosition cp = { newCenter.x + x, newCenter.z - VIEW_DISTANCE };
-            bool add = true;
-            if (deltaX != 0) {
-                for (auto & chunk : chunksToAdd) {
-                    if (chunk.x == cp.x && chunk.z == cp.z) {
-                        add = false;
-                        break;
-                    }
+
+    // A camera that stops keeps its prefetched chunks; only a new heading replaces them
+    const float speed = glm::length(cameraVelocity);
+    if (speed < TERRAIN_PREFETCH_MIN_SPEED) return;
+
+    // Step along the predicted path half a chunk at a time. Each time the predicted center chunk
+    // changes, the positions its window adds are due at that time. Positions up to half again
+    // past the horizon are kept but not started, so work at the edge is not restarted every frame.
+    const size_t limit = maxPrefetchChunks();
+    const float step = 0.5f * config.chunkSize / speed;
+    const float keepHorizon = 1.5f * TERRAIN_PREFETCH_HORIZON;
+
+    std::unordered_map<ChunkPosition, float, ChunkPositionHash> dueTimes;
+    std::vector<ChunkPosition> toStart;   // Soonest first
+    ChunkPosition lastCenter = currentCenter;
+    for (float t = step; t <= keepHorizon && dueTimes.size() < limit; t += step) {
+        glm::vec3 predicted = cameraPos + glm::vec3(cameraVelocity.x, 0.0f, cameraVelocity.y) * t;
+        ChunkPosition center = getChunkPosition(predicted);
+        if (center == lastCenter) continue;
+        lastCenter = center;
+
+        for (int x = -config.viewDistance; x <= config.viewDistance && dueTimes.size() < limit; ++x) {
+            for (int z = -config.viewDistance; z <= config.viewDistance && dueTimes.size() < limit; ++z) {
+                ChunkPosition cp = {center.x + x, center.z + z};
+                if (findChunkIndex(cp) != -1 || dueTimes.count(cp)) continue;
+
+                dueTimes[cp] = t;
+                if (t <= TERRAIN_PREFETCH_HORIZON && !prefetchFutures.count(cp) && !prefetchedChunks.count(cp)) {
+                    toStart.push_back(cp);
                 }
             }
-            if (add) chunksToAdd.push_back(cp);
         }
-        // Identify chunks to replace on the North side
-        for(int z = 0; z < -deltaZ; ++z) {
-            for(int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; ++x) {
-                ChunkPosition cp = { currentCenter.x + x, currentCenter.z + VIEW_DISTANCE + z };
-                bool replace = true;
-                if (deltaX != 0) {
-                    for (auto & chunk : chunksToReplace) {
-                        if (chunk.x == cp.x && chunk.z == cp.z) {
-                            replace = false;
-                            break;
-                        }
-                    }
-                }
-                if (replace) chunksToReplace.push_back(cp);
-            }
+    }
+
+    // Drop what the camera is no longer heading for
+    for (auto it = prefetchFutures.begin(); it != prefetchFutures.end(); ) {
+        if (dueTimes.count(it->first)) {
+            ++it;
+            continue;
+        }
+        it->second.cancelToken->store(true);
+        retiredFutures.push_back(std::move(it->second));
+        it = prefetchFutures.erase(it);
+        prefetchStats.dropped++;
+    }
+    for (auto it = prefetchedChunks.begin(); it != prefetchedChunks.end(); ) {
+        if (dueTimes.count(it->first)) {
+            ++it;
+            continue;
         }
+        it = prefetchedChunks.erase(it);
+        prefetchStats.dropped++;
     }
 
-    return true;
+    // Visible chunks always go first. Speculation gets one job per worker, and the jobs share the
+    // pool's FIFO queues with visible work, so a burst of it never delays a chunk on screen by more
+    // than one chunk's generation time.
+    const size_t maxInFlight = std::min(static_cast<size_t>(JobSystem::instance().getWorkerCount()), maxGenerationsInFlight());
+    for (const ChunkPosition& cp : toStart) {
+        if (!queuedChunks.empty() || prefetchFutures.size() >= maxInFlight) break;
+        if (generationFutures.size() + prefetchFutures.size() >= maxGenerationsInFlight()) break;
+        if (prefetchFutures.size() + prefetchedChunks.size() >= limit) break;
+
+        // Speculative jobs belong to no chunk, so a bare Terrain starts them with the shared cache
+        Terrain generator;
+        generator.setCache(&cache);
+        generator.setNoiseGraph(noiseGraph);
+
+        PendingGeneration pending;
+        pending.cancelToken = makeCancelToken();
+        pending.future = generator.generateTerrainAsync(
+            config.chunkSize, config.chunkSize, static_cast<float>(config.maxHeight),
+            static_cast<float>(cp.x * config.chunkSize), static_cast<float>(cp.z * config.chunkSize), pending.cancelToken
+        );
+        prefetchFutures[cp] = std::move(pending);
+    }
 }
 
-void TerrainManager::initialize(const glm::vec3& cameraPos) {
-    currentCenter = getChunkPosition(cameraPos);
+void TerrainManager::sortQueuedChunks() {
+    // Nearest to the camera's chunk first, by Chebyshev ring then by straight distance
+    const ChunkPosition center = currentCenter;
+    std::stable_sort(queuedChunks.begin(), queuedChunks.end(),
+        [center](const ChunkPosition& a, const ChunkPosition& b) {
+            int ax = a.x - center.x, az = a.z - center.z;
+            int bx = b.x - center.x, bz = b.z - center.z;
+            int ringA = std::max(std::abs(ax), std::abs(az));
+            int ringB = std::max(std::abs(bx), std::abs(bz));
+            if (ringA != ringB) return ringA < ringB;
+            return ax * ax + az * az < bx * bx + bz * bz;
+        });
+}
 
-    createTerrainProgramIDs(programID, depthProgramID);
+void TerrainManager::submitQueuedGenerations() {
+    // Keep a couple of jobs per worker in flight, speculative ones included; the rest wait here so
+    // a newer, closer chunk can still jump ahead of them and cancelled positions never reach the pool
+    const size_t maxInFlight = maxGenerationsInFlight();
 
-    // Load initial chunks within the view distance
-    for(int x = -VIEW_DISTANCE; x <= VIEW_DISTANCE; ++x) {
-        for(int z = -VIEW_DISTANCE; z <= VIEW_DISTANCE; ++z) {
-            ChunkPosition cp = {currentCenter.x + x, currentCenter.z + z};
+    while (!queuedChunks.empty() && generationFutures.size() + prefetchFutures.size() < maxInFlight) {
+        ChunkPosition cp = queuedChunks.front();
 
-            // Create and initialize a Chunk using a unique_ptr
-            auto chunk = createChunk(cp, programID, depthProgramID);
-
-            // Emplace the unique_ptr into the chunks vector
-            chunks.emplace_back(std::move(chunk));
+        int idx = findChunkIndex(cp);
+        if (idx == -1) {
+            queuedChunks.erase(queuedChunks.begin());
+            continue;
         }
+
+        // Wait for a slot to come back from the GPU rather than allocating more
+        StagingSlot staging = uploadRing.acquire();
+        if (staging.index < 0) break;
+        queuedChunks.erase(queuedChunks.begin());
+
+        PendingGeneration pending;
+        pending.cancelToken = makeCancelToken();
+        pending.stagingSlot = staging.index;
+        pending.future = chunks[idx]->terrain.generateTerrainAsync(
+            config.chunkSize, config.chunkSize, static_cast<float>(config.maxHeight),
+            static_cast<float>(cp.x * config.chunkSize), static_cast<float>(cp.z * config.chunkSize), pending.cancelToken, staging
+        );
+
+        // Store the future so we can poll it later in pollTerrainFutures()
+        generationFutures[cp] = std::move(pending);
     }
 }
 
+size_t TerrainManager::getPendingChunkCount() const {
+    return queuedChunks.size() + generationFutures.size();
+}
+
+void TerrainManager::cancelGeneration(const ChunkPosition& cp) {
+    queuedChunks.erase(std::remove(queuedChunks.begin(), queuedChunks.end(), cp), queuedChunks.end());
+
+    auto it = generationFutures.find(cp);
+    if (it == generationFutures.end()) return;
+
+    it->second.cancelToken->store(true);
+    retiredFutures.push_back(std::move(it->second));
+    generationFutures.erase(it);
+}
+
 // This method polls all futures in generationFutures. If any are ready, it
 // grabs the TerrainData, finds the appropriate Chunk, calls updateBuffers,
 // and removes the future from the map.
-void TerrainManager::pollTerrainFutures() {
+bool TerrainManager::pollTerrainFutures() {
+    bool updated = false;
     for (auto it = generationFutures.begin(); it != generationFutures.end(); ) {
         // Non-blocking check if the future is ready
-        if (it->second.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+        if (it->second.future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+            // Spread uploads over frames; the rest stay ready for the next one
+            if (!uploadRing.hasBudget(chunkVertexBytes())) break;
+
             // Retrieve the data
-            TerrainData data = it->second.get();
+            TerrainData data = it->second.future.get();
 
             // Find the chunk that corresponds to this position
             int idx = findChunkIndex(it->first);
             if (idx != -1) {
                 // Update the existing Terrain object's buffers
                 chunks[idx]->terrain.updateBuffers(data);
+                setHeightfield(it->first, data.heightfield);
+                updated = true;
             }
             else {
                 std::cerr << "Warning: Chunk position not found for updating buffers.\n";
             }
 
+            // Slots being copied come back through their fence; this frees the ones nothing read
+            uploadRing.release(it->second.stagingSlot);
+
             // Erase the future from our map
             it = generationFutures.erase(it);
         } else {
             ++it;
         }
     }
+
+    // Forget cancelled jobs once the workers are done with them
+    for (auto it = retiredFutures.begin(); it != retiredFutures.end(); ) {
+        if (it->future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+            uploadRing.release(it->stagingSlot);
+            it = retiredFutures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return updated;
 }
 
-// Update the TerrainManager based on the camera's new position
-void TerrainManager::update(const glm::vec3& cameraPos) {
-    ChunkPosition newCenter = getChunkPosition(cameraPos);
+void TerrainManager::resetHeightSource() {
+    noiseGraph = TerrainNoiseGraph::createPreset(config.generator, config.seed);
 
-    std::vector<ChunkPosition> chunksToAdd;
-    std::vector<ChunkPosition> chunksToReplace;
+    std::lock_guard<std::mutex> lock(heightMutex);
+    heightfields.clear();
+    heightfieldBytes = 0;
+    heightGraph = noiseGraph;
+    heightChunkSize = static_cast<float>(config.chunkSize);
+    heightMaxHeight = static_cast<float>(config.maxHeight);
+}
 
-    // Determine which chunks to add and replace based on new center
-    if (!chucksToAddReplace(newCenter, chunksToAdd, chunksToReplace)) {
-        // If no chunks to add/replace, still poll for any completed futures
-        pollTerrainFutures();
-        return;
+void TerrainManager::setHeightfield(const ChunkPosition& cp, const std::shared_ptr<const TerrainHeightfield>& heightfield) {
+    std::lock_guard<std::mutex> lock(heightMutex);
+    auto it = heightfields.find(cp);
+    if (it != heightfields.end()) {
+        heightfieldBytes -= it->second->getBytes();
+        heightfields.erase(it);
+    }
+    if (heightfield) {
+        heightfields[cp] = heightfield;
+        heightfieldBytes += heightfield->getBytes();
     }
+}
 
-    // Reassign chunk positions and initiate asynchronous terrain generation
-    for (size_t i = 0; i < chunksToReplace.size(); i++) {
-        const ChunkPosition& oldPos = chunksToReplace[i];
-        const ChunkPosition& newPos = chunksToAdd[i];
+float TerrainManager::sampleHeight(float x, float z) const {
+    float height;
+    sampleHeights(&x, &z, 1, &height);
+    return height;
+}
 
-        int idx = findChunkIndex(oldPos);
-        if (idx == -1) {
-            std::cerr << "Warning: Chunk to replace not found: (" << oldPos.x << ", " << oldPos.z << ")\n";
-            continue; // Skip if the old chunk isn't found
+glm::vec3 TerrainManager::sampleNormal(float x, float z) const {
+    float height;
+    glm::vec3 normal;
+    sampleHeights(&x, &z, 1, &height, &normal);
+    return normal;
+}
+
+void TerrainManager::sampleHeights(const float* x, const float* z, int count, float* heights, glm::vec3* normals) const {
+    std::vector<int> misses;
+    std::shared_ptr<const TerrainNoiseGraph> graph;
+    float maxHeight;
+    {
+        std::lock_guard<std::mutex> lock(heightMutex);
+        graph = heightGraph;
+        maxHeight = heightMaxHeight;
+
+        // Chunk n covers [(n - 0.5) * size, (n + 0.5) * size]. Nearby queries tend to share a
+        // chunk, so the last lookup is reused.
+        const float halfSize = heightChunkSize * 0.5f;
+        ChunkPosition lastPosition = { 0, 0 };
+        const TerrainHeightfield* field = nullptr;
+        bool looked = false;
+        for (int i = 0; i < count; ++i) {
+            ChunkPosition cp = {
+                static_cast<int>(std::floor((x[i] + halfSize) / heightChunkSize)),
+                static_cast<int>(std::floor((z[i] + halfSize) / heightChunkSize))
+            };
+            if (!looked || !(cp == lastPosition)) {
+                auto found = heightfields.find(cp);
+                field = found != heightfields.end() ? found->second.get() : nullptr;
+                lastPosition = cp;
+                looked = true;
+            }
+
+            if (field && field->contains(x[i], z[i])) {
+                heights[i] = field->sample(x[i], z[i], normals ? &normals[i] : nullptr);
+            } else {
+                misses.push_back(i);
+            }
         }
+    }
+    if (misses.empty()) return;
 
-        auto& chunkToUpdate = chunks[idx];
+    if (!graph) {
+        for (int i : misses) {
+            heights[i] = 0.0f;
+            if (normals) normals[i] = glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        return;
+    }
 
-        // Update the position
-        chunkToUpdate->position = newPos;
+    // The point itself, then with normals its four neighbours one unit away, all in one evaluation
+    const int perPoint = normals ? 5 : 1;
+    const int pointCount = static_cast<int>(misses.size()) * perPoint;
+    const float offsets[5][2] = { {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+    std::vector<float> px(pointCount), pz(pointCount), values(pointCount);
+    for (size_t m = 0; m < misses.size(); ++m) {
+        for (int k = 0; k < perPoint; ++k) {
+            px[m * perPoint + k] = x[misses[m]] + offsets[k][0];
+            pz[m * perPoint + k] = z[misses[m]] + offsets[k][1];
+        }
+    }
 
-        float posX = newPos.x * CHUNK_SIZE;
-        float posZ = newPos.z * CHUNK_SIZE;
+    TerrainNoiseGraph::Scratch scratch;
+    graph->evaluate(px.data(), pz.data(), pointCount, values.data(), scratch);
 
-        // Kick off async generation for the new chunk position
-        std::future<TerrainData> fut = chunkToUpdate->terrain.generateTerrainAsync(
-            CHUNK_SIZE, CHUNK_SIZE, MAX_HEIGHT, posX, posZ
-        );
+    for (size_t m = 0; m < misses.size(); ++m) {
+        const float* h = &values[m * perPoint];
+        heights[misses[m]] = h[0] * maxHeight;
 
-        // Store the future so we can poll it later in pollTerrainFutures()
-        generationFutures[newPos] = std::move(fut);
+        // Central differences, like the generator's vertex normals
+        if (normals) normals[misses[m]] = glm::normalize(glm::vec3((h[1] - h[2]) * maxHeight, 2.0f, (h[3] - h[4]) * maxHeight));
     }
+}
 
-    currentCenter = newCenter;
+void TerrainManager::setProjection(float fovY, int viewportHeight) {
+    screenErrorScale = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+bool TerrainManager::updateLods(const glm::vec3& cameraPos) {
+    std::vector<int> levels(chunks.size(), 0);
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const Chunk& chunk = *chunks[i];
+
+        // Distance to the chunk's bounding box; a chunk the camera is above gets full detail
+        float halfSize = config.chunkSize / 2.0f;
+        glm::vec3 center(chunk.position.x * config.chunkSize, 0.0f, chunk.position.z * config.chunkSize);
+        glm::vec3 extent(halfSize, static_cast<float>(config.maxHeight), halfSize);
+        glm::vec3 outside = glm::max(glm::abs(cameraPos - center) - extent, glm::vec3(0.0f));
+        float distance = std::max(glm::length(outside), 1.0f);
+
+        // Screen-space error is the geometric error scaled by the perspective at that distance
+        int level = 0;
+        for (int l = TERRAIN_LOD_LEVELS - 1; l > 0; --l) {
+            if (chunk.terrain.getGeometricError(l) * screenErrorScale / distance <= config.maxScreenError) {
+                level = l;
+                break;
+            }
+        }
+        levels[i] = level;
+    }
+
+    const int offsets[EDGE_COUNT][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} }; // West, East, South, North
+    auto neighbourIndex = [&](size_t i, int edge) -> int {
+        ChunkPosition cp = { chunks[i]->position.x + offsets[edge][0], chunks[i]->position.z + offsets[edge][1] };
+        return findChunkIndex(cp);
+    };
+
+    // Refine chunks that are more than one level coarser than a neighbour until none are left
+    bool relaxed = true;
+    while (relaxed) {
+        relaxed = false;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            for (int edge = 0; edge < EDGE_COUNT; ++edge) {
+                int n = neighbourIndex(i, edge);
+                if (n != -1 && levels[i] > levels[n] + 1) {
+                    levels[i] = levels[n] + 1;
+                    relaxed = true;
+                }
+            }
+        }
+    }
+
+    bool changed = false;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        // Chunks at the edge of the loaded area have nothing to stitch against
+        int neighbourLevels[EDGE_COUNT];
+        for (int edge = 0; edge < EDGE_COUNT; ++edge) {
+            int n = neighbourIndex(i, edge);
+            neighbourLevels[edge] = n == -1 ? levels[i] : levels[n];
+        }
+        if (chunks[i]->terrain.setLod(levels[i], neighbourLevels)) changed = true;
+    }
+    return changed;
+}
+
+int TerrainManager::getTriangleCount() const {
+    int triangles = 0;
+    for (auto& chunkPtr : chunks) {
+        triangles += chunkPtr->terrain.getTriangleCount();
+    }
+    return triangles;
+}
+
+// Update the TerrainManager based on the camera's new position
+bool TerrainManager::update(const glm::vec3& cameraPos, float deltaTime) {
+    uploadRing.beginFrame();
+    trackCameraVelocity(cameraPos, deltaTime);
+
+    // Hand the slots of chunks that left the view window to the positions that entered it
+    rewrapChunks(getChunkPosition(cameraPos));
 
     // Poll to see if any of the new or old generation tasks have completed
-    pollTerrainFutures();
+    bool updated = pollTerrainFutures();
+    submitQueuedGenerations();
+    updatePrefetch(cameraPos);
+    enforceCpuBudget(cameraPos);
+    return updateLods(cameraPos) || updated;
+}
+
+TerrainManager::GridUniforms TerrainManager::getGridUniformLocations(GLuint program) {
+    GridUniforms uniforms;
+    uniforms.gridWidth = glGetUniformLocation(program, "gridWidth");
+    uniforms.verticesPerChunk = glGetUniformLocation(program, "verticesPerChunk");
+    uniforms.heightRange = glGetUniformLocation(program, "heightRange");
+    uniforms.uvScale = glGetUniformLocation(program, "uvScale");
+    uniforms.chunkOrigins = glGetUniformLocation(program, "chunkOrigins");
+    return uniforms;
+}
+
+void TerrainManager::setGridUniforms(const GridUniforms& uniforms, int originTextureUnit) const {
+    // The grass texture repeats this many times across a chunk
+    const float tilingFactor = 25.0f;
+
+    glUniform1i(uniforms.gridWidth, vertexPool.getWidth());
+    glUniform1i(uniforms.verticesPerChunk, vertexPool.getVerticesPerPage());
+    glUniform1f(uniforms.heightRange, static_cast<float>(config.maxHeight));
+    glUniform2f(uniforms.uvScale, tilingFactor / vertexPool.getWidth(), tilingFactor / vertexPool.getDepth());
+
+    glActiveTexture(GL_TEXTURE0 + originTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, vertexPool.getOriginTextureID());
+    glUniform1i(uniforms.chunkOrigins, originTextureUnit);
+}
+
+void TerrainManager::drawBatch() {
+    glBindVertexArray(vertexPool.getVertexArrayID());
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawList.counts.data(), GL_UNSIGNED_INT, drawList.offsets.data(),
+                                  drawList.size(), drawList.baseVertices.data());
+    glBindVertexArray(0);
+}
+
+void TerrainManager::renderDepth(const ShadowMap& shadowMap) {
+    const Frustum lightFrustum(shadowMap.getLightSpaceMatrix());
+
+    drawList.clear();
+    for(auto& chunkPtr : chunks) {
+        const Terrain& terrain = chunkPtr->terrain;
+        if (!lightFrustum.intersectsBox(terrain.getBoundsMin(), terrain.getBoundsMax(), false)) continue;
+
+        terrain.appendDraws(drawList);
+    }
+
+    if (!drawList.empty()) {
+        glUseProgram(depthProgramID);
+        glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, &shadowMap.getLightSpaceMatrix()[0][0]);
+        setGridUniforms(depthGridUniforms, 0);
+        drawBatch();
+    }
+
+    // Hand the cascade's shared depth program back to the casters drawn after the terrain
+    glUseProgram(shadowMap.getDepthProgramID());
 }
 
-void TerrainManager::render(const glm::mat4& vp, const glm::mat4& lightSpaceMatrix,
-                            const glm::vec3& lightDirection, const glm::vec3& lightIntensity,
-                            const glm::vec3& cameraPos)
+void TerrainManager::render(const glm::mat4& vp, const glm::vec3& lightDirection, const glm::vec3& lightIntensity,
+                            const glm::vec3& cameraPos, const CascadedShadowMap& shadowMaps)
 {
-    // First update (which also polls for async completions)
-    update(cameraPos);
+    const Frustum frustum(vp);
+    cullStats = TerrainCullStats();
 
-    // Now draw all chunks
+    drawList.clear();
     for(auto& chunkPtr : chunks) {
-        chunkPtr->terrain.render(vp, lightSpaceMatrix, lightDirection, lightIntensity, cameraPos);
+        const Terrain& terrain = chunkPtr->terrain;
+        glm::vec3 boundsMin = terrain.getBoundsMin();
+        glm::vec3 boundsMax = terrain.getBoundsMax();
+
+        // terrain.frag fades by horizontal distance, so only x and z count here
+        float dx = std::max(std::max(boundsMin.x - cameraPos.x, cameraPos.x - boundsMax.x), 0.0f);
+        float dz = std::max(std::max(boundsMin.z - cameraPos.z, cameraPos.z - boundsMax.z), 0.0f);
+        if (dx * dx + dz * dz > TERRAIN_FOG_END * TERRAIN_FOG_END) {
+            cullStats.fogCulled++;
+            continue;
+        }
+
+        if (!frustum.intersectsBox(boundsMin, boundsMax)) {
+            cullStats.frustumCulled++;
+            continue;
+        }
+
+        terrain.appendDraws(drawList);
+        cullStats.drawn++;
+        cullStats.drawnTriangles += terrain.getTriangleCount();
     }
+
+    if (drawList.empty()) return;
+
+    glUseProgram(programID);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glUniform1i(textureSamplerID, 0);
+
+    // Cascades go on the texture units after the grass texture, the chunk origins after them
+    shadowMaps.bindForSampling(shadowUniforms, 1);
+    setGridUniforms(gridUniforms, 1 + MAX_SHADOW_CASCADES);
+
+    glm::mat4 model = glm::mat4(1.0f);
+    glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &vp[0][0]);
+    glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &model[0][0]);
+
+    glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
+    glUniform3fv(lightDirectionID, 1, &lightDirection[0]);
+    glUniform3fv(cameraPosID, 1, &cameraPos[0]);
+
+    drawBatch();
 }
 
-void TerrainManager::cleanup() {
-    // Make sure all futures are finished (optional):
-    // If you want to ensure absolutely no background threads left:
+void TerrainManager::finishGenerations() {
+    // Cancel outstanding jobs and wait for the ones already running, since they
+    // still write into their staging slots
     for (auto & kv : generationFutures) {
-        // Just block until done.
-        kv.second.wait();
+        kv.second.cancelToken->store(true);
+        retiredFutures.push_back(std::move(kv.second));
+    }
+    for (auto & kv : prefetchFutures) {
+        kv.second.cancelToken->store(true);
+        retiredFutures.push_back(std::move(kv.second));
+    }
+    for (auto & retired : retiredFutures) {
+        retired.future.wait();
+        uploadRing.release(retired.stagingSlot);
     }
     generationFutures.clear();
+    prefetchFutures.clear();
+    prefetchedChunks.clear();
+    retiredFutures.clear();
+    queuedChunks.clear();
+}
+
+void TerrainManager::cleanup() {
+    finishGenerations();
 
     // Cleanup chunk GPU resources
     for(auto& chunkPtr : chunks) {
-        chunkPtr->terrain.cleanup();
+        destroyChunk(*chunkPtr);
     }
     chunks.clear();
 
+    vertexPool.cleanup();
+    releaseGridBuffers(poolGrid);
+    poolGrid.reset();
+
+    uploadRing.cleanup();
+
+    glDeleteTextures(1, &textureID);
     glDeleteProgram(programID);
     glDeleteProgram(depthProgramID);
+
+    TerrainCacheStats cacheStats = cache.getStats();
+    std::cout << "Terrain cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+              << cacheStats.evictions << " evictions, " << cacheStats.bytesOnDisk / (1024 * 1024) << " MB on disk" << std::endl;
+    cache.cleanup();
+
+    std::cout << "Terrain prefetch: " << prefetchStats.ready << " chunks ready in time, " << prefetchStats.running
+              << " still generating, " << prefetchStats.dropped << " dropped" << std::endl;
 }
@@ -2,15 +2,39 @@
 #define TERRAIN_MANAGER_H
 
 #include "terrain.h"
+#include "TerrainCache.h"
+#include "TerrainConfig.h"
+#include "TerrainNoiseGraph.h"
+#include "TerrainHeightfield.h"
+#include "Frustum.h"
+#include "CascadedShadowMap.h"
+#include <map>
+#include <mutex>
 #include <unordered_map>
 #include <glm/glm.hpp>
 #include <future>
 #include <vector>
 
-const int CHUNK_SIZE = 500;
-const int MAX_HEIGHT = 30;
+// Generated chunks are kept on disk, about 1 MB each
+const char* const TERRAIN_CACHE_DIRECTORY = "terrain_cache";
+const size_t TERRAIN_CACHE_MAX_BYTES = 512u * 1024u * 1024u;
 
-const int VIEW_DISTANCE = 4; // 1 for a 3x3 grid, 3 for a 5x5 grid
+// Vertex bytes copied into chunk buffers per frame, about four chunks
+const size_t TERRAIN_UPLOAD_BUDGET_BYTES = 4u * 1024u * 1024u;
+
+// Horizontal distance past which terrain.frag fades everything out, at its largest
+const float TERRAIN_FOG_END = 2000.0f;
+
+// Chunks the camera is heading towards are generated ahead of time, up to this many seconds
+// before they enter the view window and this much vertex data held in memory
+const float TERRAIN_PREFETCH_HORIZON = 2.0f;
+const size_t TERRAIN_PREFETCH_MAX_BYTES = 64u * 1024u * 1024u;
+
+// Below this speed, in world units per second, the camera counts as standing still
+const float TERRAIN_PREFETCH_MIN_SPEED = 10.0f;
+
+// Key repeat moves the camera in steps a few frames apart; its velocity is averaged over this many seconds
+const float TERRAIN_VELOCITY_SMOOTHING = 0.25f;
 
 
 // Structure to uniquely identify each chunk by its grid position
@@ -32,6 +56,40 @@ struct ChunkPositionHash {
     }
 };
 
+// Memory held by the terrain against its budgets, for comparing configurations
+struct TerrainMemoryStats {
+    // GPU
+    size_t vertexBytes = 0;    // Per-chunk vertex buffers
+    size_t gridBytes = 0;      // Shared index and placeholder buffers
+    size_t stagingBytes = 0;   // Upload ring
+
+    // CPU
+    size_t heightfieldBytes = 0;  // Heights kept for the sample functions
+    size_t prefetchBytes = 0;     // Chunks generated ahead of the camera
+    size_t jobBytes = 0;          // Working memory of the generation jobs in flight
+
+    size_t gpuBudget = 0;
+    size_t cpuBudget = 0;
+
+    size_t gpuBytes() const { return vertexBytes + gridBytes + stagingBytes; }
+    size_t cpuBytes() const { return heightfieldBytes + prefetchBytes + jobBytes; }
+};
+
+// Chunks considered by the last camera pass and why the skipped ones were skipped
+struct TerrainCullStats {
+    int drawn = 0;
+    int frustumCulled = 0;
+    int fogCulled = 0;
+    int drawnTriangles = 0;
+};
+
+// Chunks generated ahead of the camera, by what became of them
+struct TerrainPrefetchStats {
+    int ready = 0;      // Done before their position entered the view window
+    int running = 0;    // Entered while still generating, but with a head start
+    int dropped = 0;    // Given up after the camera turned away
+};
+
 struct Chunk {
     ChunkPosition position;
     Terrain terrain;
@@ -47,35 +105,230 @@ struct Chunk {
 
 class TerrainManager {
 public:
-    void initialize(const glm::vec3& cameraPos);
-    void update(const glm::vec3& cameraPos);
-    void render(const glm::mat4& vp, const glm::mat4& lightSpaceMatrix,
-                const glm::vec3& lightDirection, const glm::vec3& lightIntensity,
-                const glm::vec3& cameraPos);
+    void initialize(const glm::vec3& cameraPos, const TerrainConfig& initialConfig = TerrainConfig());
+
+    // Switch to new settings without a restart. A view distance change only creates or drops
+    // the chunks at the border; a chunk size or height change regenerates every chunk.
+    void applyConfig(const TerrainConfig& newConfig, const glm::vec3& cameraPos);
+    const TerrainConfig& getConfig() const { return config; }
+
+    TerrainMemoryStats getMemoryStats() const;
+
+    // Stream chunks around the camera and pick each chunk's LOD level. deltaTime is the time since
+    // the last update, for estimating where the camera is heading.
+    // Returns true when terrain geometry changed this frame.
+    bool update(const glm::vec3& cameraPos, float deltaTime);
+
+    // Perspective used to turn a chunk's geometric error into pixels on screen
+    void setProjection(float fovY, int viewportHeight);
+
+    // Triangles drawn per terrain pass with the current LOD selection, for profiling
+    int getTriangleCount() const;
+
+    // Chunks still showing a placeholder or stale terrain: queued plus generating.
+    // Zero means every chunk in view has its final geometry.
+    size_t getPendingChunkCount() const;
+
+    // Each pass draws every visible chunk with one glMultiDrawElementsBaseVertex. Both passes skip
+    // chunks outside the view, tested against each chunk's bounding box; the camera pass also
+    // skips chunks that are entirely in the fog.
+    void renderDepth(const ShadowMap& shadowMap);
+    void render(const glm::mat4& vp, const glm::vec3& lightDirection, const glm::vec3& lightIntensity,
+                const glm::vec3& cameraPos, const CascadedShadowMap& shadowMaps);
+
+    const TerrainCullStats& getCullStats() const { return cullStats; }
+    const TerrainPrefetchStats& getPrefetchStats() const { return prefetchStats; }
+
+    // Ground height and normal at world (x, z), callable from any thread. Inside chunks with their
+    // final geometry this is a bilinear interpolation of the LOD 0 grid heights, which can differ
+    // from the drawn triangles inside a quad, and more so at coarser LODs; anywhere else the noise
+    // graph is evaluated at that point.
+    float sampleHeight(float x, float z) const;
+    glm::vec3 sampleNormal(float x, float z) const;
+
+    // The same for count points at once, under one lock and one noise evaluation; normals may be null
+    void sampleHeights(const float* x, const float* z, int count, float* heights, glm::vec3* normals = nullptr) const;
+
     void cleanup();
 
 private:
+    TerrainConfig config;
+
+    // Toroidal grid of config.gridSize() squared slots. A position lives in the slot given
+    // by its coordinates modulo the grid size, so lookups are direct and moving the camera only
+    // rewrites the positions of the slots that wrapped around.
     std::vector<std::unique_ptr<Chunk>> chunks;
     ChunkPosition currentCenter;
 
+    // A chunk generation job running on the JobSystem, with the token used to cancel it
+    // and the upload slot it writes its vertices into
+    struct PendingGeneration {
+        std::future<TerrainData> future;
+        CancelToken cancelToken;
+        int stagingSlot = -1;
+    };
+
     // Stores futures for terrains that are being generated asynchronously.
     // Key: The chunk position for which generation is in progress
     // Value: The future that will yield the TerrainData
-    std::unordered_map<ChunkPosition, std::future<TerrainData>, ChunkPositionHash> generationFutures;
+    std::unordered_map<ChunkPosition, PendingGeneration, ChunkPositionHash> generationFutures;
+
+    // Positions waiting for a generation job, nearest to currentCenter first
+    std::vector<ChunkPosition> queuedChunks;
+
+    // Queue a position that entered the window, unless it was already prefetched
+    void queueGeneration(const ChunkPosition& cp);
+
+    // Restore nearest-first order after queueing, relative to currentCenter
+    void sortQueuedChunks();
+
+    // Start queued jobs while fewer than the in-flight limit are running
+    void submitQueuedGenerations();
 
+    // Cancelled jobs that may still be running; kept so cleanup can wait for them
+    // and their staging slots are only released once the worker stopped writing
+    std::vector<PendingGeneration> retiredFutures;
+
+    // Staging buffers that finished jobs are copied from, one per job in flight
+    UploadRing uploadRing;
+
+    // Shared, reference-counted index/UV buffers keyed by chunk resolution (width, depth)
+    std::map<std::pair<int, int>, std::shared_ptr<TerrainGridBuffers>> gridBuffers;
+
+    std::shared_ptr<TerrainGridBuffers> acquireGridBuffers(int width, int depth);
+    void releaseGridBuffers(const std::shared_ptr<TerrainGridBuffers>& grid);
+
+    std::unique_ptr<Chunk> createChunk(const ChunkPosition& cp);
+    void destroyChunk(Chunk& chunk);
+
+    // Size the chunk grid for the current config around currentCenter, creating and queueing the
+    // chunks that are missing. With regenerate set, existing chunks are replaced as well.
+    void rebuildChunkGrid(bool regenerate);
+
+    void initializeUploadRing();
+
+    // One page per chunk slot; every chunk's vertices, drawn through one vertex array
+    TerrainVertexPool vertexPool;
+    std::shared_ptr<TerrainGridBuffers> poolGrid;
+
+    // Recreate the pool for the current chunk size; only valid while no chunk holds a page
+    void initializeVertexPool();
+    size_t chunkVertexBytes() const;
+
+    // Horizontal camera velocity, smoothed, and the position it was last measured from
+    glm::vec2 cameraVelocity;
+    glm::vec3 lastCameraPos;
+    void trackCameraVelocity(const glm::vec3& cameraPos, float deltaTime);
+
+    // Speculative jobs for positions outside the window that the camera is moving towards. They have
+    // no staging slot, and their finished data waits in prefetchedChunks until the position enters
+    // the window or the camera turns away.
+    std::unordered_map<ChunkPosition, PendingGeneration, ChunkPositionHash> prefetchFutures;
+    std::unordered_map<ChunkPosition, TerrainData, ChunkPositionHash> prefetchedChunks;
+    TerrainPrefetchStats prefetchStats;
+
+    // Collect finished speculative jobs, then plan along the camera's velocity: drop the positions it
+    // no longer heads for and start the ones it reaches soonest while no visible chunk is waiting
+    void updatePrefetch(const glm::vec3& cameraPos);
+
+    // Move a prefetched position's data or running job over to generationFutures
+    bool adoptPrefetch(const ChunkPosition& cp);
+    size_t maxPrefetchChunks() const;
+
+    // Cancel every job, wait for the running ones and empty the queue
+    void finishGenerations();
+
+    int chunkSlot(const ChunkPosition& cp) const;
+
+    // Index of the chunk holding this position, or -1 if it is outside the loaded window
     int findChunkIndex(const ChunkPosition &cp) const;
     ChunkPosition getChunkPosition(const glm::vec3& pos);
 
-    bool chucksToAddReplace(ChunkPosition newCenter,
-                            std::vector<ChunkPosition>& chunksToAdd,
-                            std::vector<ChunkPosition>& chunksToReplace);
+    // Move the window to newCenter, reassigning and queueing every slot whose position left it.
+    // Returns false if the center did not change.
+    bool rewrapChunks(ChunkPosition newCenter);
 
     // Poll all known futures to see if they are ready. If so, update buffers
     // on the associated chunk, and remove them from generationFutures.
-    void pollTerrainFutures();
+    // Returns true if any chunk was updated.
+    bool pollTerrainFutures();
+
+    // Cancel the generation job for a chunk position the camera has already left
+    void cancelGeneration(const ChunkPosition& cp);
+
+    // Choose a level per chunk from its screen-space error, then limit neighbours to one level
+    // apart so the stitched edges line up. Returns true if any chunk changed what it draws.
+    bool updateLods(const glm::vec3& cameraPos);
+
+    // Pixels per world unit at distance 1: viewportHeight / (2 * tan(fovY / 2))
+    float screenErrorScale = 927.0f;
 
     GLuint programID = 0;
     GLuint depthProgramID = 0;
+    GLuint textureID = 0;
+
+    // Chunk layout uniforms, for the render and the depth program
+    struct GridUniforms {
+        GLint gridWidth = -1;
+        GLint verticesPerChunk = -1;
+        GLint heightRange = -1;
+        GLint uvScale = -1;
+        GLint chunkOrigins = -1;
+    };
+    GridUniforms gridUniforms;
+    GridUniforms depthGridUniforms;
+
+    static GridUniforms getGridUniformLocations(GLuint program);
+    void setGridUniforms(const GridUniforms& uniforms, int originTextureUnit) const;
+
+    GLint mvpMatrixID = -1;
+    GLint modelMatrixID = -1;
+    GLint textureSamplerID = -1;
+    GLint lightIntensityID = -1;
+    GLint lightDirectionID = -1;
+    GLint cameraPosID = -1;
+    CascadeUniforms shadowUniforms;
+    GLint depthLightSpaceMatrixID = -1;
+
+    // Rebuilt every pass; kept to reuse its storage
+    TerrainDrawList drawList;
+    void drawBatch();
+
+    TerrainCache cache;
+    TerrainCullStats cullStats;
+
+    // Built from config.generator and config.seed, shared by every generation job
+    std::shared_ptr<const TerrainNoiseGraph> noiseGraph;
+
+    // What the sample functions read, guarded by heightMutex since they may run on any thread:
+    // the heights of every chunk whose final geometry is uploaded, and the settings for the rest
+    mutable std::mutex heightMutex;
+    std::unordered_map<ChunkPosition, std::shared_ptr<const TerrainHeightfield>, ChunkPositionHash> heightfields;
+    std::shared_ptr<const TerrainNoiseGraph> heightGraph;
+    float heightChunkSize = 0.0f;
+    float heightMaxHeight = 0.0f;
+    size_t heightfieldBytes = 0;   // Only the main thread changes heightfields, so it may read this unlocked
+
+    // Rebuild noiseGraph from the config and drop every heightfield made with the old settings
+    void resetHeightSource();
+    void setHeightfield(const ChunkPosition& cp, const std::shared_ptr<const TerrainHeightfield>& heightfield);
+
+    // Lower newConfig's view distance until its GPU memory fits the budget
+    void fitGpuBudget(TerrainConfig& newConfig) const;
+    size_t estimateGpuBytes(const TerrainConfig& newConfig) const;
+
+    // CPU memory of one generation job while it runs, and of one finished chunk kept in memory
+    size_t jobWorkingBytes() const;
+    size_t prefetchedChunkBytes(const TerrainData& data) const;
+    size_t cpuBudgetBytes() const { return static_cast<size_t>(config.cpuBudgetMB) * 1024 * 1024; }
+
+    // Generation jobs allowed in flight at once, at most two per worker
+    size_t maxGenerationsInFlight() const;
+    int stagingSlotCount() const;
+
+    // Drop prefetched chunks, then the heights of the chunks farthest from the camera, until the
+    // CPU memory fits the budget. Chunks without heights answer height queries from the noise.
+    void enforceCpuBudget(const glm::vec3& cameraPos);
 };
 
 #endif
@@ -0,0 +1,456 @@
+#include "TerrainNoise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#define STB_PERLIN_IMPLEMENTATION
+#include "stb_perlin.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TERRAIN_NOISE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TERRAIN_NOISE_TARGET(isa)
+#else
+#define TERRAIN_NOISE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace {
+
+const int MAX_OCTAVES = 16;
+
+// stb_perlin's permutation and gradient tables, widened to 32 bits so the vector paths can
+// gather from them. The terrain samples at z = 0, so only the x and y gradient components matter.
+struct NoiseTables {
+    int perm[512];
+    float gradX[512];
+    float gradY[512];
+
+    NoiseTables() {
+        for (int i = 0; i < 512; ++i) {
+            int gradIndex = stb__perlin_randtab_grad_idx[i];
+            perm[i] = stb__perlin_randtab[i];
+            gradX[i] = stb__perlin_grad(gradIndex, 1.0f, 0.0f, 0.0f);
+            gradY[i] = stb__perlin_grad(gradIndex, 0.0f, 1.0f, 0.0f);
+        }
+    }
+};
+
+const NoiseTables& noiseTables() {
+    static NoiseTables tables;
+    return tables;
+}
+
+// Per-octave frequency and amplitude, accumulated in the same order as the original scalar loop
+struct Octaves {
+    int count = 0;
+    float frequency[MAX_OCTAVES];
+    float amplitude[MAX_OCTAVES];
+    float maxAmplitude = 0.0f; // For normalization
+    int seed = 0;
+    NoiseFractal fractal = NOISE_FBM;
+    float offsetX = 0.0f;
+    float offsetZ = 0.0f;
+
+    explicit Octaves(const FbmParams& params) {
+        count = std::max(1, std::min(params.octaves, MAX_OCTAVES));
+        seed = params.seed & 255;
+        fractal = params.fractal;
+        offsetX = params.offsetX;
+        offsetZ = params.offsetZ;
+
+        float f = params.scale;
+        float a = 1.0f;
+        for (int i = 0; i < count; ++i) {
+            frequency[i] = f;
+            amplitude[i] = a;
+            maxAmplitude += a;
+            a *= params.persistence;
+            f *= params.lacunarity;
+        }
+    }
+};
+
+// Every kernel performs the same float operations in the same order, so they agree bit for bit
+typedef void (*FbmRowFunction)(const Octaves& octaves, const float* x, const float* z, int count, float* out);
+
+// ---- Scalar ----
+
+inline float ease(float a) { return ((a * 6 - 15) * a + 10) * a * a * a; }
+inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+// stb_perlin_noise3(x, y, 0) without wrapping; at z = 0 the far z corners get zero weight
+float perlinScalar(const NoiseTables& t, float x, float y, int seed) {
+    int px = stb__perlin_fastfloor(x);
+    int py = stb__perlin_fastfloor(y);
+    int x0 = px & 255, x1 = (px + 1) & 255;
+    int y0 = py & 255, y1 = (py + 1) & 255;
+
+    x -= px;
+    y -= py;
+    float u = ease(x);
+    float v = ease(y);
+
+    int r0 = t.perm[x0 + seed];
+    int r1 = t.perm[x1 + seed];
+    int r00 = t.perm[r0 + y0];
+    int r01 = t.perm[r0 + y1];
+    int r10 = t.perm[r1 + y0];
+    int r11 = t.perm[r1 + y1];
+
+    float n00 = t.gradX[r00] * x + t.gradY[r00] * y;
+    float n01 = t.gradX[r01] * x + t.gradY[r01] * (y - 1);
+    float n10 = t.gradX[r10] * (x - 1) + t.gradY[r10] * y;
+    float n11 = t.gradX[r11] * (x - 1) + t.gradY[r11] * (y - 1);
+
+    return lerp(lerp(n00, n01, v), lerp(n10, n11, v), u);
+}
+
+inline float shapeScalar(float perlin, NoiseFractal fractal) {
+    switch (fractal) {
+        case NOISE_RIDGED: {
+            float ridge = 1.0f - std::fabs(perlin);
+            return ridge * ridge * 2.0f - 1.0f;
+        }
+        case NOISE_BILLOW: return std::fabs(perlin) * 2.0f - 1.0f;
+        default: return perlin;
+    }
+}
+
+void fbmRowScalar(const Octaves& octaves, const float* x, const float* z, int count, float* out) {
+    const NoiseTables& t = noiseTables();
+    for (int i = 0; i < count; ++i) {
+        float noiseValue = 0.0f;
+        for (int o = 0; o < octaves.count; ++o) {
+            float perlin = perlinScalar(t, x[i] * octaves.frequency[o] + octaves.offsetX,
+                                        z[i] * octaves.frequency[o] + octaves.offsetZ, octaves.seed);
+            noiseValue += shapeScalar(perlin, octaves.fractal) * octaves.amplitude[o];
+        }
+        out[i] = noiseValue / octaves.maxAmplitude;
+    }
+}
+
+#ifdef TERRAIN_NOISE_X86
+
+// ---- SSE4.1, 4 samples per step ----
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128i gatherSse(const int* table, __m128i index) {
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+    return _mm_setr_epi32(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128 gatherSse(const float* table, __m128i index) {
+    alignas(16) int i[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+    return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128 easeSse(__m128 a) {
+    __m128 e = _mm_sub_ps(_mm_mul_ps(a, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+    e = _mm_add_ps(_mm_mul_ps(e, a), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(e, a), a), a);
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128 lerpSse(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128 perlinSse(const NoiseTables& t, __m128 x, __m128 y, __m128i seed) {
+    const __m128i mask = _mm_set1_epi32(255);
+    const __m128i oneInt = _mm_set1_epi32(1);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 fx = _mm_floor_ps(x);
+    __m128 fy = _mm_floor_ps(y);
+    __m128i px = _mm_cvttps_epi32(fx);
+    __m128i py = _mm_cvttps_epi32(fy);
+    __m128i x0 = _mm_and_si128(px, mask), x1 = _mm_and_si128(_mm_add_epi32(px, oneInt), mask);
+    __m128i y0 = _mm_and_si128(py, mask), y1 = _mm_and_si128(_mm_add_epi32(py, oneInt), mask);
+
+    x = _mm_sub_ps(x, fx);
+    y = _mm_sub_ps(y, fy);
+    __m128 u = easeSse(x);
+    __m128 v = easeSse(y);
+    __m128 xm1 = _mm_sub_ps(x, one);
+    __m128 ym1 = _mm_sub_ps(y, one);
+
+    __m128i r0 = gatherSse(t.perm, _mm_add_epi32(x0, seed));
+    __m128i r1 = gatherSse(t.perm, _mm_add_epi32(x1, seed));
+    __m128i r00 = gatherSse(t.perm, _mm_add_epi32(r0, y0));
+    __m128i r01 = gatherSse(t.perm, _mm_add_epi32(r0, y1));
+    __m128i r10 = gatherSse(t.perm, _mm_add_epi32(r1, y0));
+    __m128i r11 = gatherSse(t.perm, _mm_add_epi32(r1, y1));
+
+    __m128 n00 = _mm_add_ps(_mm_mul_ps(gatherSse(t.gradX, r00), x), _mm_mul_ps(gatherSse(t.gradY, r00), y));
+    __m128 n01 = _mm_add_ps(_mm_mul_ps(gatherSse(t.gradX, r01), x), _mm_mul_ps(gatherSse(t.gradY, r01), ym1));
+    __m128 n10 = _mm_add_ps(_mm_mul_ps(gatherSse(t.gradX, r10), xm1), _mm_mul_ps(gatherSse(t.gradY, r10), y));
+    __m128 n11 = _mm_add_ps(_mm_mul_ps(gatherSse(t.gradX, r11), xm1), _mm_mul_ps(gatherSse(t.gradY, r11), ym1));
+
+    return lerpSse(lerpSse(n00, n01, v), lerpSse(n10, n11, v), u);
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+inline __m128 shapeSse(__m128 perlin, NoiseFractal fractal) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 absolute = _mm_andnot_ps(_mm_set1_ps(-0.0f), perlin);
+    switch (fractal) {
+        case NOISE_RIDGED: {
+            __m128 ridge = _mm_sub_ps(one, absolute);
+            return _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(ridge, ridge), two), one);
+        }
+        case NOISE_BILLOW: return _mm_sub_ps(_mm_mul_ps(absolute, two), one);
+        default: return perlin;
+    }
+}
+
+TERRAIN_NOISE_TARGET("sse4.1")
+void fbmRowSse41(const Octaves& octaves, const float* x, const float* z, int count, float* out) {
+    const NoiseTables& t = noiseTables();
+    const __m128i seed = _mm_set1_epi32(octaves.seed);
+    const __m128 maxAmplitude = _mm_set1_ps(octaves.maxAmplitude);
+    const __m128 offsetX = _mm_set1_ps(octaves.offsetX);
+    const __m128 offsetZ = _mm_set1_ps(octaves.offsetZ);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 worldX = _mm_loadu_ps(x + i);
+        __m128 worldZ = _mm_loadu_ps(z + i);
+        __m128 noiseValue = _mm_setzero_ps();
+        for (int o = 0; o < octaves.count; ++o) {
+            __m128 frequency = _mm_set1_ps(octaves.frequency[o]);
+            __m128 perlin = perlinSse(t, _mm_add_ps(_mm_mul_ps(worldX, frequency), offsetX),
+                                      _mm_add_ps(_mm_mul_ps(worldZ, frequency), offsetZ), seed);
+            noiseValue = _mm_add_ps(noiseValue, _mm_mul_ps(shapeSse(perlin, octaves.fractal), _mm_set1_ps(octaves.amplitude[o])));
+        }
+        _mm_storeu_ps(out + i, _mm_div_ps(noiseValue, maxAmplitude));
+    }
+    fbmRowScalar(octaves, x + i, z + i, count - i, out + i);
+}
+
+// ---- AVX2, 8 samples per step with hardware gathers ----
+
+TERRAIN_NOISE_TARGET("avx2")
+inline __m256 easeAvx2(__m256 a) {
+    __m256 e = _mm256_sub_ps(_mm256_mul_ps(a, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+    e = _mm256_add_ps(_mm256_mul_ps(e, a), _mm256_set1_ps(10.0f));
+    return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(e, a), a), a);
+}
+
+TERRAIN_NOISE_TARGET("avx2")
+inline __m256 lerpAvx2(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+TERRAIN_NOISE_TARGET("avx2")
+inline __m256 perlinAvx2(const NoiseTables& t, __m256 x, __m256 y, __m256i seed) {
+    const __m256i mask = _mm256_set1_epi32(255);
+    const __m256i oneInt = _mm256_set1_epi32(1);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 fx = _mm256_floor_ps(x);
+    __m256 fy = _mm256_floor_ps(y);
+    __m256i px = _mm256_cvttps_epi32(fx);
+    __m256i py = _mm256_cvttps_epi32(fy);
+    __m256i x0 = _mm256_and_si256(px, mask), x1 = _mm256_and_si256(_mm256_add_epi32(px, oneInt), mask);
+    __m256i y0 = _mm256_and_si256(py, mask), y1 = _mm256_and_si256(_mm256_add_epi32(py, oneInt), mask);
+
+    x = _mm256_sub_ps(x, fx);
+    y = _mm256_sub_ps(y, fy);
+    __m256 u = easeAvx2(x);
+    __m256 v = easeAvx2(y);
+    __m256 xm1 = _mm256_sub_ps(x, one);
+    __m256 ym1 = _mm256_sub_ps(y, one);
+
+    __m256i r0 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(x0, seed), 4);
+    __m256i r1 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(x1, seed), 4);
+    __m256i r00 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(r0, y0), 4);
+    __m256i r01 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(r0, y1), 4);
+    __m256i r10 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(r1, y0), 4);
+    __m256i r11 = _mm256_i32gather_epi32(t.perm, _mm256_add_epi32(r1, y1), 4);
+
+    __m256 n00 = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(t.gradX, r00, 4), x),
+                               _mm256_mul_ps(_mm256_i32gather_ps(t.gradY, r00, 4), y));
+    __m256 n01 = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(t.gradX, r01, 4), x),
+                               _mm256_mul_ps(_mm256_i32gather_ps(t.gradY, r01, 4), ym1));
+    __m256 n10 = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(t.gradX, r10, 4), xm1),
+                               _mm256_mul_ps(_mm256_i32gather_ps(t.gradY, r10, 4), y));
+    __m256 n11 = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(t.gradX, r11, 4), xm1),
+                               _mm256_mul_ps(_mm256_i32gather_ps(t.gradY, r11, 4), ym1));
+
+    return lerpAvx2(lerpAvx2(n00, n01, v), lerpAvx2(n10, n11, v), u);
+}
+
+TERRAIN_NOISE_TARGET("avx2")
+inline __m256 shapeAvx2(__m256 perlin, NoiseFractal fractal) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 absolute = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), perlin);
+    switch (fractal) {
+        case NOISE_RIDGED: {
+            __m256 ridge = _mm256_sub_ps(one, absolute);
+            return _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(ridge, ridge), two), one);
+        }
+        case NOISE_BILLOW: return _mm256_sub_ps(_mm256_mul_ps(absolute, two), one);
+        default: return perlin;
+    }
+}
+
+TERRAIN_NOISE_TARGET("avx2")
+void fbmRowAvx2(const Octaves& octaves, const float* x, const float* z, int count, float* out) {
+    const NoiseTables& t = noiseTables();
+    const __m256i seed = _mm256_set1_epi32(octaves.seed);
+    const __m256 maxAmplitude = _mm256_set1_ps(octaves.maxAmplitude);
+    const __m256 offsetX = _mm256_set1_ps(octaves.offsetX);
+    const __m256 offsetZ = _mm256_set1_ps(octaves.offsetZ);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 worldX = _mm256_loadu_ps(x + i);
+        __m256 worldZ = _mm256_loadu_ps(z + i);
+        __m256 noiseValue = _mm256_setzero_ps();
+        for (int o = 0; o < octaves.count; ++o) {
+            __m256 frequency = _mm256_set1_ps(octaves.frequency[o]);
+            __m256 perlin = perlinAvx2(t, _mm256_add_ps(_mm256_mul_ps(worldX, frequency), offsetX),
+                                       _mm256_add_ps(_mm256_mul_ps(worldZ, frequency), offsetZ), seed);
+            noiseValue = _mm256_add_ps(noiseValue, _mm256_mul_ps(shapeAvx2(perlin, octaves.fractal), _mm256_set1_ps(octaves.amplitude[o])));
+        }
+        _mm256_storeu_ps(out + i, _mm256_div_ps(noiseValue, maxAmplitude));
+    }
+    fbmRowScalar(octaves, x + i, z + i, count - i, out + i);
+}
+
+bool cpuHasSse41() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    if (!osSavesAvx) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // TERRAIN_NOISE_X86
+
+bool cpuHasScalar() { return true; }
+
+struct FbmKernel {
+    const char* name;
+    FbmRowFunction function;
+    bool (*supported)();
+};
+
+// Best first
+const FbmKernel fbmKernels[] = {
+#ifdef TERRAIN_NOISE_X86
+    { "AVX2", fbmRowAvx2, cpuHasAvx2 },
+    { "SSE4.1", fbmRowSse41, cpuHasSse41 },
+#endif
+    { "scalar", fbmRowScalar, cpuHasScalar },
+};
+
+// Sample positions (firstX + i, z), computed the same way for every kernel
+void fillRow(float firstX, float z, int count, float* x, float* zs) {
+    for (int i = 0; i < count; ++i) {
+        x[i] = firstX + i;
+        zs[i] = z;
+    }
+}
+
+// The fastest kernel the CPU supports. Agreement with stb_perlin and bit-identity with plain C are
+// checked by terrain_noise_test, not at startup.
+const FbmKernel& selectKernel() {
+    const int kernelCount = sizeof(fbmKernels) / sizeof(fbmKernels[0]);
+    int i = 0;
+    while (i < kernelCount - 1 && !fbmKernels[i].supported()) ++i;
+
+    std::cout << "Terrain noise: using " << fbmKernels[i].name << std::endl;
+    return fbmKernels[i];
+}
+
+const FbmKernel& activeKernel() {
+    static const FbmKernel& kernel = selectKernel();
+    return kernel;
+}
+
+} // namespace
+
+void fractalNoise(const FbmParams& params, const float* x, const float* z, int count, float* out) {
+    activeKernel().function(Octaves(params), x, z, count, out);
+}
+
+void fbmNoiseRow(const FbmParams& params, float firstX, float z, int count, float* out) {
+    const Octaves octaves(params);
+    const int blockSize = 256;
+    float x[blockSize], zs[blockSize];
+
+    for (int first = 0; first < count; first += blockSize) {
+        int block = std::min(blockSize, count - first);
+        fillRow(firstX + first, z, block, x, zs);
+        activeKernel().function(octaves, x, zs, block, out + first);
+    }
+}
+
+const char* fbmNoiseIsa() {
+    return activeKernel().name;
+}
+
+int fbmKernelCount() {
+    return sizeof(fbmKernels) / sizeof(fbmKernels[0]);
+}
+
+const char* fbmKernelName(int kernel) {
+    return fbmKernels[kernel].name;
+}
+
+bool fbmKernelSupported(int kernel) {
+    return fbmKernels[kernel].supported();
+}
+
+void fractalNoiseOnKernel(int kernel, const FbmParams& params, const float* x, const float* z, int count, float* out) {
+    fbmKernels[kernel].function(Octaves(params), x, z, count, out);
+}
+
+void benchmarkFbmNoise(int width, int depth) {
+    FbmParams params;
+    Octaves octaves(params);
+    std::vector<float> x(width + 1), z(width + 1), row(width + 1);
+
+    for (const FbmKernel& kernel : fbmKernels) {
+        if (!kernel.supported()) continue;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i <= depth; ++i) {
+            fillRow(-width / 2.0f, i - depth / 2.0f, width + 1, x.data(), z.data());
+            kernel.function(octaves, x.data(), z.data(), width + 1, row.data());
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double verticesPerSecond = (width + 1.0) * (depth + 1.0) / elapsed.count();
+        std::cout << "Terrain noise " << kernel.name << ": " << verticesPerSecond / 1e6 << "M vertices/s" << std::endl;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef TERRAIN_NOISE_H
+#define TERRAIN_NOISE_H
+
+// Fractal Perlin noise for the terrain heightfield. Plain fBm produces the same values as summing
+// stb_perlin_noise3(x, z, 0) octaves, but whole rows of samples are evaluated at a time with
+// SSE4.1 or AVX2 when the CPU has them. The fastest instruction set the CPU supports is picked once
+// at startup. Every version gives bit-identical results to the plain C one, so generated terrain
+// does not depend on the machine; terrain_noise_test checks that and the match with stb_perlin.
+
+// How each octave's Perlin value is shaped before the octaves are summed; all stay in [-1, 1]
+enum NoiseFractal {
+    NOISE_FBM = 0,   // As is
+    NOISE_RIDGED,    // Sharp crests where the noise crosses zero
+    NOISE_BILLOW     // Rounded bumps, the absolute value of the noise
+};
+
+struct FbmParams {
+    float scale = 0.02f;       // Frequency of the first octave
+    int octaves = 6;           // Number of layers of noise
+    float persistence = 0.4f;  // Amplitude multiplier for each octave
+    float lacunarity = 2.0f;   // Frequency multiplier for each octave
+    int seed = 0;              // Same meaning as stb_perlin_noise3_seed, only the low 8 bits are used
+    NoiseFractal fractal = NOISE_FBM;
+
+    // Added to every octave's lattice coordinates, to pick another part of the noise
+    float offsetX = 0.0f;
+    float offsetZ = 0.0f;
+};
+
+// Normalized fractal noise in [-1, 1] at (x[i], z[i]) for i in [0, count), written to out
+void fractalNoise(const FbmParams& params, const float* x, const float* z, int count, float* out);
+
+// Normalized fBm in [-1, 1] at (firstX + i, z) for i in [0, count), written to out
+void fbmNoiseRow(const FbmParams& params, float firstX, float z, int count, float* out);
+
+// Name of the instruction set fbmNoiseRow runs on, e.g. "AVX2"
+const char* fbmNoiseIsa();
+
+// The instruction sets the noise can run on, fastest first; the last is plain C and always supported
+int fbmKernelCount();
+const char* fbmKernelName(int kernel);
+bool fbmKernelSupported(int kernel);
+
+// fractalNoise on the given instruction set instead of the picked one, for tests. The CPU must support it.
+void fractalNoiseOnKernel(int kernel, const FbmParams& params, const float* x, const float* z, int count, float* out);
+
+// Time one chunk's worth of samples on every instruction set this CPU supports and print vertices/s
+void benchmarkFbmNoise(int width, int depth);
+
+#endif
@@ -0,0 +1,300 @@
+#include "TerrainNoiseGraph.h"
+#include "Fnv1a.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Mixes the graph seed with a source index. Zero maps to zero, so source 0 of seed 0 is
+// exactly the unseeded noise the terrain always used.
+uint32_t sourceHash(uint32_t seed, uint32_t index) {
+    uint32_t h = (seed * 0x9E3779B1u) ^ (index * 0x85EBCA77u);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+FbmParams makeParams(float scale, int octaves, float persistence, NoiseFractal fractal) {
+    FbmParams params;
+    params.scale = scale;
+    params.octaves = octaves;
+    params.persistence = persistence;
+    params.fractal = fractal;
+    return params;
+}
+
+} // namespace
+
+TerrainNoiseGraph::TerrainNoiseGraph(uint32_t seed) : seed(seed) {}
+
+bool TerrainNoiseGraph::isPreset(const std::string& name) {
+    return name == "classic" || name == "biomes";
+}
+
+std::shared_ptr<const TerrainNoiseGraph> TerrainNoiseGraph::createPreset(const std::string& name, uint32_t seed) {
+    std::shared_ptr<TerrainNoiseGraph> graph(new TerrainNoiseGraph(seed));
+
+    if (name == "classic") {
+        graph->compile(graph->fractal(FbmParams()));
+    } else if (name == "biomes") {
+        // Which biome a place belongs to, changing over a few kilometres
+        Node continent = graph->fractal(makeParams(0.0015f, 3, 0.5f, NOISE_FBM));
+
+        Node plains = graph->scaleBias(graph->fractal(makeParams(0.01f, 4, 0.5f, NOISE_BILLOW)), 0.15f, -0.45f);
+        Node hills = graph->scaleBias(graph->fractal(FbmParams()), 0.5f, 0.0f);
+
+        // Ridges bent by a slow warp so they meander instead of following the noise lattice
+        Node warpX = graph->fractal(makeParams(0.004f, 2, 0.5f, NOISE_FBM));
+        Node warpZ = graph->fractal(makeParams(0.004f, 2, 0.5f, NOISE_FBM));
+        Node ridges = graph->warpedFractal(makeParams(0.006f, 5, 0.5f, NOISE_RIDGED), warpX, warpZ, 80.0f);
+        Node mountains = graph->scaleBias(ridges, 0.6f, 0.4f);
+
+        Node lowlands = graph->blend(plains, hills, continent, -0.25f, 0.05f);
+        graph->compile(graph->blend(lowlands, mountains, continent, 0.15f, 0.45f));
+    } else {
+        return nullptr;
+    }
+
+    return graph;
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::addNode(const NodeDesc& desc) {
+    NodeDesc checked = desc;
+    for (Node& input : checked.inputs) {
+        if (input >= static_cast<Node>(nodes.size())) {
+            std::cerr << "Terrain noise graph: node " << nodes.size() << " reads node " << input
+                      << " that does not exist yet, using 0 instead" << std::endl;
+            input = constant(0.0f);
+        }
+    }
+    nodes.push_back(checked);
+    return static_cast<Node>(nodes.size() - 1);
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::constant(float value) {
+    NodeDesc desc;
+    desc.type = NODE_CONSTANT;
+    desc.values[0] = value;
+    return addNode(desc);
+}
+
+TerrainNoiseGraph::NodeDesc TerrainNoiseGraph::seededSource(const FbmParams& params) {
+    NodeDesc desc;
+    desc.type = NODE_FRACTAL;
+    desc.noise = params;
+
+    // stb_perlin only has 256 seeds; the lattice offset multiplies that by 65536
+    uint32_t h = sourceHash(seed, static_cast<uint32_t>(sourceCount++));
+    desc.noise.seed = (params.seed + static_cast<int>(h & 255u)) & 255;
+    desc.noise.offsetX += static_cast<float>((h >> 8) & 255u);
+    desc.noise.offsetZ += static_cast<float>((h >> 16) & 255u);
+    return desc;
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::fractal(const FbmParams& params) {
+    return addNode(seededSource(params));
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::warpedFractal(const FbmParams& params, Node warpX, Node warpZ, float strength) {
+    NodeDesc desc = seededSource(params);
+    desc.type = NODE_WARPED_FRACTAL;
+    desc.inputs[0] = warpX;
+    desc.inputs[1] = warpZ;
+    desc.values[0] = strength;
+    return addNode(desc);
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::add(Node a, Node b) {
+    NodeDesc desc;
+    desc.type = NODE_ADD;
+    desc.inputs[0] = a;
+    desc.inputs[1] = b;
+    return addNode(desc);
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::multiply(Node a, Node b) {
+    NodeDesc desc;
+    desc.type = NODE_MULTIPLY;
+    desc.inputs[0] = a;
+    desc.inputs[1] = b;
+    return addNode(desc);
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::scaleBias(Node input, float scale, float bias) {
+    NodeDesc desc;
+    desc.type = NODE_SCALE_BIAS;
+    desc.inputs[0] = input;
+    desc.values[0] = scale;
+    desc.values[1] = bias;
+    return addNode(desc);
+}
+
+TerrainNoiseGraph::Node TerrainNoiseGraph::blend(Node low, Node high, Node control, float lower, float upper) {
+    NodeDesc desc;
+    desc.type = NODE_BLEND;
+    desc.inputs[0] = low;
+    desc.inputs[1] = high;
+    desc.inputs[2] = control;
+    desc.values[0] = lower;
+    desc.values[1] = upper > lower ? 1.0f / (upper - lower) : 0.0f; // 0 makes a hard switch at lower
+    return addNode(desc);
+}
+
+void TerrainNoiseGraph::compile(Node output) {
+    if (output < 0 || output >= static_cast<Node>(nodes.size())) {
+        std::cerr << "Terrain noise graph: output node " << output << " does not exist, using 0" << std::endl;
+        output = constant(0.0f);
+    }
+
+    // Inputs always come before their readers, so one backward pass finds every node the output needs
+    std::vector<bool> live(nodes.size(), false);
+    live[output] = true;
+    for (Node node = output; node >= 0; --node) {
+        if (!live[node]) continue;
+        for (Node input : nodes[node].inputs) {
+            if (input >= 0) live[input] = true;
+        }
+    }
+
+    std::vector<int> stepOf(nodes.size(), -1);
+    std::vector<int> lastRead(nodes.size(), -1);
+    program.clear();
+    for (Node node = 0; node <= output; ++node) {
+        if (!live[node]) continue;
+        stepOf[node] = static_cast<int>(program.size());
+        for (Node input : nodes[node].inputs) {
+            if (input >= 0) lastRead[input] = stepOf[node];
+        }
+        Step step;
+        step.node = node;
+        program.push_back(step);
+    }
+
+    // Give each step the lowest free row, and free its inputs' rows after their last reader
+    std::vector<bool> slotUsed;
+    std::vector<int> slotOf(nodes.size(), -1);
+    for (size_t s = 0; s < program.size(); ++s) {
+        Step& step = program[s];
+        const NodeDesc& desc = nodes[step.node];
+
+        for (int i = 0; i < 3; ++i) {
+            if (desc.inputs[i] >= 0) step.inputSlots[i] = slotOf[desc.inputs[i]];
+        }
+
+        auto freeSlot = std::find(slotUsed.begin(), slotUsed.end(), false);
+        step.slot = static_cast<int>(freeSlot - slotUsed.begin());
+        if (freeSlot == slotUsed.end()) slotUsed.push_back(true);
+        else *freeSlot = true;
+        slotOf[step.node] = step.slot;
+
+        for (Node input : desc.inputs) {
+            if (input >= 0 && lastRead[input] == static_cast<int>(s)) slotUsed[slotOf[input]] = false;
+        }
+    }
+    slotCount = static_cast<int>(slotUsed.size());
+    outputSlot = slotOf[output];
+
+    // Hash the program by step, so unused nodes and node numbering do not matter
+    // Field by field, so padding never reaches the hash
+    Fnv1a fnv;
+    fnv.add(seed);
+    for (const Step& step : program) {
+        const NodeDesc& desc = nodes[step.node];
+        fnv.add(static_cast<int32_t>(desc.type));
+        for (Node input : desc.inputs) fnv.add(static_cast<int32_t>(input >= 0 ? stepOf[input] : -1));
+        fnv.add(desc.values[0]);
+        fnv.add(desc.values[1]);
+        if (desc.type == NODE_FRACTAL || desc.type == NODE_WARPED_FRACTAL) {
+            fnv.add(desc.noise.scale);
+            fnv.add(static_cast<int32_t>(desc.noise.octaves));
+            fnv.add(desc.noise.persistence);
+            fnv.add(desc.noise.lacunarity);
+            fnv.add(static_cast<int32_t>(desc.noise.seed));
+            fnv.add(static_cast<int32_t>(desc.noise.fractal));
+            fnv.add(desc.noise.offsetX);
+            fnv.add(desc.noise.offsetZ);
+        }
+    }
+    hash = fnv.hash;
+}
+
+void TerrainNoiseGraph::evaluate(const float* x, const float* z, int count, float* out, Scratch& scratch) const {
+    if (count <= 0) return;
+    if (program.empty()) {
+        std::fill(out, out + count, 0.0f);
+        return;
+    }
+
+    // Two rows for warped positions, then one per slot
+    const size_t rowSize = static_cast<size_t>(count);
+    if (scratch.rows.size() < (slotCount + 2) * rowSize) scratch.rows.resize((slotCount + 2) * rowSize);
+    float* warpedX = scratch.rows.data();
+    float* warpedZ = warpedX + rowSize;
+    auto row = [&](int slot) { return scratch.rows.data() + (slot + 2) * rowSize; };
+
+    for (const Step& step : program) {
+        const NodeDesc& desc = nodes[step.node];
+        float* result = row(step.slot);
+        const float* a = step.inputSlots[0] >= 0 ? row(step.inputSlots[0]) : nullptr;
+        const float* b = step.inputSlots[1] >= 0 ? row(step.inputSlots[1]) : nullptr;
+        const float* c = step.inputSlots[2] >= 0 ? row(step.inputSlots[2]) : nullptr;
+
+        switch (desc.type) {
+            case NODE_CONSTANT:
+                std::fill(result, result + count, desc.values[0]);
+                break;
+            case NODE_FRACTAL:
+                fractalNoise(desc.noise, x, z, count, result);
+                break;
+            case NODE_WARPED_FRACTAL: {
+                const float strength = desc.values[0];
+                for (int i = 0; i < count; ++i) {
+                    warpedX[i] = x[i] + strength * a[i];
+                    warpedZ[i] = z[i] + strength * b[i];
+                }
+                fractalNoise(desc.noise, warpedX, warpedZ, count, result);
+                break;
+            }
+            case NODE_ADD:
+                for (int i = 0; i < count; ++i) result[i] = a[i] + b[i];
+                break;
+            case NODE_MULTIPLY:
+                for (int i = 0; i < count; ++i) result[i] = a[i] * b[i];
+                break;
+            case NODE_SCALE_BIAS:
+                for (int i = 0; i < count; ++i) result[i] = a[i] * desc.values[0] + desc.values[1];
+                break;
+            case NODE_BLEND: {
+                const float lower = desc.values[0];
+                const float inverseRange = desc.values[1];
+                for (int i = 0; i < count; ++i) {
+                    float t;
+                    if (inverseRange > 0.0f) {
+                        t = std::min(std::max((c[i] - lower) * inverseRange, 0.0f), 1.0f);
+                        t = t * t * (3.0f - 2.0f * t);
+                    } else {
+                        t = c[i] >= lower ? 1.0f : 0.0f;
+                    }
+                    result[i] = a[i] + (b[i] - a[i]) * t;
+                }
+                break;
+            }
+        }
+    }
+
+    std::copy(row(outputSlot), row(outputSlot) + count, out);
+}
+
+void TerrainNoiseGraph::evaluateRow(float firstX, float z, int count, float* out, Scratch& scratch) const {
+    if (count <= 0) return;
+
+    // Positions live outside scratch.rows, which evaluate may grow
+    scratch.x.resize(count);
+    scratch.z.assign(count, z);
+    for (int i = 0; i < count; ++i) scratch.x[i] = firstX + i;
+    evaluate(scratch.x.data(), scratch.z.data(), count, out, scratch);
+}
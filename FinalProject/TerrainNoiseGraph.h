@@ -0,0 +1,108 @@
+#ifndef TERRAIN_NOISE_GRAPH_H
+#define TERRAIN_NOISE_GRAPH_H
+
+#include "TerrainNoise.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Terrain height as a graph of noise sources and operators, evaluated a whole row of samples at a
+// time: every node runs over the full row before the next one starts, so the fractal sources use the
+// vectorized kernels and the operators are simple loops.
+//
+// Nodes are added inputs first and refer to each other by the Node handles the builders return.
+// compile() then keeps the nodes the output depends on and assigns each a row buffer, reusing buffers
+// once their last reader ran. A compiled graph is immutable and can be shared by every worker.
+//
+// Only the terrain seed and the graph decide the output. Every operation is plain float arithmetic in
+// a fixed order on every instruction set, so a seed gives bit-identical terrain on every machine, which
+// keeps cached chunks and reference images valid.
+class TerrainNoiseGraph {
+public:
+    typedef int Node;
+
+    explicit TerrainNoiseGraph(uint32_t seed = 0);
+
+    // Built-in graphs, selected by name in TerrainConfig:
+    // "classic" is the original single fBm layer; "biomes" blends plains, hills and warped ridged
+    // mountains by a low-frequency continent noise. Unknown names give nullptr.
+    static std::shared_ptr<const TerrainNoiseGraph> createPreset(const std::string& name, uint32_t seed);
+    static bool isPreset(const std::string& name);
+
+    Node constant(float value);
+
+    // Seeded fractal noise in [-1, 1]. The params' seed and lattice offset are shifted by a hash of
+    // the graph seed and the source's index, so every source and every graph seed differ.
+    Node fractal(const FbmParams& params);
+
+    // Fractal noise sampled at (x + strength * warpX, z + strength * warpZ)
+    Node warpedFractal(const FbmParams& params, Node warpX, Node warpZ, float strength);
+
+    Node add(Node a, Node b);
+    Node multiply(Node a, Node b);
+    Node scaleBias(Node input, float scale, float bias);
+
+    // low where control <= lower, high where control >= upper, smoothstepped in between
+    Node blend(Node low, Node high, Node control, float lower, float upper);
+
+    // Plan the evaluation of output; call once, after the last node was added
+    void compile(Node output);
+
+    // Row buffers for one thread's evaluations, reused between calls
+    struct Scratch {
+        std::vector<float> rows;
+        std::vector<float> x, z;   // Positions for evaluateRow
+    };
+
+    // Height at (x[i], z[i]), roughly in [-1, 1], for i in [0, count)
+    void evaluate(const float* x, const float* z, int count, float* out, Scratch& scratch) const;
+
+    // Height at (firstX + i, z) for i in [0, count)
+    void evaluateRow(float firstX, float z, int count, float* out, Scratch& scratch) const;
+
+    // Covers the compiled nodes and the seed, for cache keys
+    uint64_t getHash() const { return hash; }
+    uint32_t getSeed() const { return seed; }
+
+private:
+    enum NodeType {
+        NODE_CONSTANT,
+        NODE_FRACTAL,
+        NODE_WARPED_FRACTAL,
+        NODE_ADD,
+        NODE_MULTIPLY,
+        NODE_SCALE_BIAS,
+        NODE_BLEND
+    };
+
+    struct NodeDesc {
+        NodeType type = NODE_CONSTANT;
+        Node inputs[3] = { -1, -1, -1 };
+        float values[2] = { 0.0f, 0.0f };
+        FbmParams noise;
+    };
+
+    // One compiled node: its row buffer and those of its inputs
+    struct Step {
+        Node node = -1;
+        int slot = -1;
+        int inputSlots[3] = { -1, -1, -1 };
+    };
+
+    uint32_t seed = 0;
+    int sourceCount = 0;
+    std::vector<NodeDesc> nodes;
+
+    std::vector<Step> program;
+    int slotCount = 0;
+    int outputSlot = -1;
+    uint64_t hash = 0;
+
+    Node addNode(const NodeDesc& desc);
+
+    // A fractal node with its seed and lattice offset derived from the graph seed
+    NodeDesc seededSource(const FbmParams& params);
+};
+
+#endif
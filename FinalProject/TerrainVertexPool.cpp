@@ -0,0 +1,148 @@
+#include "TerrainVertexPool.h"
+#include "terrain.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+void TerrainVertexPool::initialize(int pageCount, int width, int depth, GLuint indexBufferID) {
+    this->width = width;
+    this->depth = depth;
+    this->indexBufferID = indexBufferID;
+    verticesPerPage = (width + 1) * (depth + 1);
+
+    used.assign(pageCount, false);
+    origins.assign(2 * pageCount, 0.0f);
+    createBuffers();
+}
+
+size_t TerrainVertexPool::getPageBytes() const {
+    return static_cast<size_t>(verticesPerPage) * sizeof(TerrainVertex);
+}
+
+void TerrainVertexPool::createBuffers() {
+    glGenBuffers(1, &bufferID);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+    glBufferData(GL_ARRAY_BUFFER, getCapacityBytes(), NULL, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &originBufferID);
+    glBindBuffer(GL_TEXTURE_BUFFER, originBufferID);
+    glBufferData(GL_TEXTURE_BUFFER, origins.size() * sizeof(GLfloat), origins.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &originTextureID);
+    glBindTexture(GL_TEXTURE_BUFFER, originTextureID);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, originBufferID);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // Both attributes are read as raw integers and scaled in the shader
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+
+    glEnableVertexAttribArray(0); // Heights
+    glVertexAttribPointer(0, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(TerrainVertex),
+                          reinterpret_cast<void*>(offsetof(TerrainVertex, height)));
+
+    glEnableVertexAttribArray(3); // Normals
+    glVertexAttribPointer(3, 2, GL_BYTE, GL_FALSE, sizeof(TerrainVertex),
+                          reinterpret_cast<void*>(offsetof(TerrainVertex, normal)));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+
+    glBindVertexArray(0);
+}
+
+void TerrainVertexPool::deleteBuffers() {
+    glDeleteVertexArrays(1, &vertexArrayID);
+    glDeleteBuffers(1, &bufferID);
+    glDeleteTextures(1, &originTextureID);
+    glDeleteBuffers(1, &originBufferID);
+    vertexArrayID = 0;
+    bufferID = 0;
+    originTextureID = 0;
+    originBufferID = 0;
+}
+
+std::vector<int> TerrainVertexPool::resize(int pageCount) {
+    std::vector<int> remap(used.size(), -1);
+
+    GLuint oldBufferID = bufferID;
+    bufferID = 0;
+    glDeleteVertexArrays(1, &vertexArrayID);
+    glDeleteTextures(1, &originTextureID);
+    glDeleteBuffers(1, &originBufferID);
+
+    std::vector<bool> oldUsed;
+    std::vector<GLfloat> oldOrigins;
+    oldUsed.swap(used);
+    oldOrigins.swap(origins);
+    used.assign(pageCount, false);
+    origins.assign(2 * pageCount, 0.0f);
+
+    // Pack the allocated pages to the front; the caller released the ones it no longer needs
+    int next = 0;
+    for (size_t page = 0; page < oldUsed.size(); ++page) {
+        if (!oldUsed[page]) continue;
+        if (next >= pageCount) {
+            std::cerr << "Terrain vertex pool resized below its allocated pages" << std::endl;
+            break;
+        }
+        remap[page] = next;
+        used[next] = true;
+        origins[2 * next] = oldOrigins[2 * page];
+        origins[2 * next + 1] = oldOrigins[2 * page + 1];
+        ++next;
+    }
+
+    createBuffers();
+
+    // Move the vertices on the GPU, merging runs of pages that stay contiguous into one copy
+    glBindBuffer(GL_COPY_READ_BUFFER, oldBufferID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+    size_t page = 0;
+    while (page < remap.size()) {
+        if (remap[page] < 0) {
+            ++page;
+            continue;
+        }
+        size_t run = 1;
+        while (page + run < remap.size() && remap[page + run] == remap[page] + static_cast<int>(run)) ++run;
+
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            getPageOffset(static_cast<int>(page)), getPageOffset(remap[page]), run * getPageBytes());
+        page += run;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &oldBufferID);
+
+    return remap;
+}
+
+int TerrainVertexPool::allocate() {
+    // Lowest free page first, which keeps the used pages packed
+    auto it = std::find(used.begin(), used.end(), false);
+    if (it == used.end()) return -1;
+
+    *it = true;
+    return static_cast<int>(it - used.begin());
+}
+
+void TerrainVertexPool::release(int page) {
+    if (page >= 0 && page < static_cast<int>(used.size())) used[page] = false;
+}
+
+void TerrainVertexPool::setOrigin(int page, float x, float z) {
+    origins[2 * page] = x;
+    origins[2 * page + 1] = z;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, originBufferID);
+    glBufferSubData(GL_TEXTURE_BUFFER, 2 * page * sizeof(GLfloat), 2 * sizeof(GLfloat), &origins[2 * page]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void TerrainVertexPool::cleanup() {
+    deleteBuffers();
+    used.clear();
+    origins.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef TERRAIN_VERTEX_POOL_H
+#define TERRAIN_VERTEX_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include "glad/gl.h"
+
+// Every chunk's vertices in one buffer, one fixed-size page per chunk, so all chunks share one
+// vertex array and the whole terrain draws with a single glMultiDrawElementsBaseVertex.
+// A draw's base vertex is its page times the page's vertex count; the shaders divide gl_VertexID
+// by that count to find the page, and read the page's grid origin from a buffer texture.
+class TerrainVertexPool {
+public:
+    // pageCount pages of (width + 1) * (depth + 1) vertices, drawn with the given index buffer
+    void initialize(int pageCount, int width, int depth, GLuint indexBufferID);
+
+    // Change the number of pages, keeping the contents and origins of allocated pages. Allocated
+    // pages are packed to the front, so they may move: the result maps old pages to new ones.
+    std::vector<int> resize(int pageCount);
+
+    // Returns -1 when every page is in use
+    int allocate();
+    void release(int page);
+
+    // World x and z of the page's first vertex, read by the shaders
+    void setOrigin(int page, float x, float z);
+
+    GLuint getVertexArrayID() const { return vertexArrayID; }
+    GLuint getBufferID() const { return bufferID; }
+    GLuint getOriginTextureID() const { return originTextureID; }
+
+    int getWidth() const { return width; }
+    int getDepth() const { return depth; }
+    int getVerticesPerPage() const { return verticesPerPage; }
+    size_t getPageBytes() const;
+    size_t getPageOffset(int page) const { return static_cast<size_t>(page) * getPageBytes(); }
+    GLint getBaseVertex(int page) const { return page * verticesPerPage; }
+
+    int getPageCount() const { return static_cast<int>(used.size()); }
+    size_t getCapacityBytes() const { return used.size() * getPageBytes(); }
+
+    void cleanup();
+
+private:
+    int width = 0;
+    int depth = 0;
+    int verticesPerPage = 0;
+    GLuint indexBufferID = 0;
+
+    GLuint vertexArrayID = 0;
+    GLuint bufferID = 0;
+    GLuint originBufferID = 0;
+    GLuint originTextureID = 0;
+
+    std::vector<bool> used;
+    std::vector<GLfloat> origins;   // x and z per page
+
+    // Allocate the buffers for the current page count and record the vertex layout
+    void createBuffers();
+    void deleteBuffers();
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "UploadRing.h"
+
+#include <iostream>
+
+void UploadRing::initialize(int slotCount, size_t slotSize, size_t frameBudgetBytes) {
+    this->slotSize = slotSize;
+    frameBudget = frameBudgetBytes;
+
+    slots.resize(slotCount);
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.bufferID);
+        glBindBuffer(GL_COPY_READ_BUFFER, slot.bufferID);
+        glBufferData(GL_COPY_READ_BUFFER, slotSize, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void UploadRing::beginFrame() {
+    bytesThisFrame = 0;
+
+    for (Slot& slot : slots) {
+        if (slot.state != SLOT_COPYING) continue;
+
+        // Non-blocking check: the slot comes back once the GPU has finished reading it
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+            slot.state = SLOT_FREE;
+        }
+    }
+}
+
+StagingSlot UploadRing::acquire() {
+    StagingSlot staging;
+
+    // Round-robin from the last handed out slot, so reuse is spread over the ring
+    for (size_t n = 0; n < slots.size(); ++n) {
+        int index = (nextSlot + static_cast<int>(n)) % static_cast<int>(slots.size());
+        Slot& slot = slots[index];
+        if (slot.state != SLOT_FREE) continue;
+
+        // The fence already guaranteed the GPU is done with the old contents
+        glBindBuffer(GL_COPY_WRITE_BUFFER, slot.bufferID);
+        void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, slotSize,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (!mapped) {
+            std::cerr << "Failed to map staging buffer " << index << std::endl;
+            return staging;
+        }
+
+        slot.state = SLOT_MAPPED;
+        nextSlot = (index + 1) % static_cast<int>(slots.size());
+
+        staging.index = index;
+        staging.mapped = mapped;
+        staging.capacity = slotSize;
+        return staging;
+    }
+
+    return staging;
+}
+
+bool UploadRing::hasBudget(size_t bytes) const {
+    return bytesThisFrame == 0 || bytesThisFrame + bytes <= frameBudget;
+}
+
+void UploadRing::copyToBuffer(int index, GLuint destination, size_t destinationOffset, size_t bytes) {
+    Slot& slot = slots[index];
+
+    glBindBuffer(GL_COPY_READ_BUFFER, slot.bufferID);
+    if (glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_FALSE) {
+        // The driver lost the mapping (e.g. a mode switch); the contents are undefined but harmless
+        std::cerr << "Staging buffer " << index << " was corrupted while mapped" << std::endl;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, destinationOffset, bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = SLOT_COPYING;
+    bytesThisFrame += bytes;
+}
+
+void UploadRing::release(int index) {
+    if (index < 0) return;
+
+    Slot& slot = slots[index];
+    if (slot.state != SLOT_MAPPED) return;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, slot.bufferID);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    slot.state = SLOT_FREE;
+}
+
+int UploadRing::getFreeSlotCount() const {
+    int count = 0;
+    for (const Slot& slot : slots) {
+        if (slot.state == SLOT_FREE) ++count;
+    }
+    return count;
+}
+
+void UploadRing::cleanup() {
+    for (int i = 0; i < static_cast<int>(slots.size()); ++i) {
+        release(i);
+        if (slots[i].fence) glDeleteSync(slots[i].fence);
+        glDeleteBuffers(1, &slots[i].bufferID);
+    }
+    slots.clear();
+}
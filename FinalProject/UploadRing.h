@@ -0,0 +1,67 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <cstddef>
+#include <vector>
+#include "glad/gl.h"
+
+// A staging buffer handed to a worker: it writes up to capacity bytes at mapped
+struct StagingSlot {
+    int index = -1;
+    void* mapped = nullptr;
+    size_t capacity = 0;
+};
+
+// Ring of staging buffers for streaming data to the GPU without reallocating the destination.
+// A free slot is mapped on the render thread and handed to a worker job, which fills the mapped
+// memory directly. Once the job is done the render thread unmaps it and issues a GPU-side copy
+// into the destination buffer, then fences the slot so it is only reused after the copy ran.
+//
+// GL 3.3 has no persistent mapping and a buffer cannot be copied from while mapped, so each slot
+// is its own buffer object rather than a region of one large buffer.
+class UploadRing {
+public:
+    void initialize(int slotCount, size_t slotSize, size_t frameBudgetBytes);
+
+    // Call once per frame on the render thread: resets the budget and recycles fenced slots
+    void beginFrame();
+
+    // Map a free slot for writing. Returns a slot with index -1 when every slot is busy.
+    StagingSlot acquire();
+
+    // True while this frame's budget can take another copy of the given size.
+    // The first copy of a frame is always allowed so large uploads still make progress.
+    bool hasBudget(size_t bytes) const;
+
+    // Unmap the slot and copy its first bytes into destination at destinationOffset
+    void copyToBuffer(int slot, GLuint destination, size_t destinationOffset, size_t bytes);
+
+    // Count bytes uploaded without a staging slot, e.g. with glBufferSubData, against the budget
+    void countUpload(size_t bytes) { bytesThisFrame += bytes; }
+
+    // Give back a slot whose contents are not needed, e.g. from a cancelled job. Ignores -1.
+    void release(int slot);
+
+    size_t getBytesThisFrame() const { return bytesThisFrame; }
+    int getFreeSlotCount() const;
+    size_t getCapacityBytes() const { return slots.size() * slotSize; }
+
+    void cleanup();
+
+private:
+    enum SlotState { SLOT_FREE, SLOT_MAPPED, SLOT_COPYING };
+
+    struct Slot {
+        GLuint bufferID = 0;
+        SlotState state = SLOT_FREE;
+        GLsync fence = 0;
+    };
+
+    std::vector<Slot> slots;
+    size_t slotSize = 0;
+    size_t frameBudget = 0;
+    size_t bytesThisFrame = 0;
+    int nextSlot = 0;
+};
+
+#endif
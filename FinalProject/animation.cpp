@@ -8,6 +8,7 @@
 #include <random>
 #include <math.h>
 #include <render/shader.h>
+#include "AssetManager.h"
 
 // GLTF model loader
 #define TINYGLTF_IMPLEMENTATION
@@ -275,7 +276,7 @@ void MyBot::updateSkinning(const std::vector<glm::mat4> &nodeTransforms) {
 
 	for (SkinObject &skinObject : skinObjects) {
 		for (int j = 0; j < skinObject.jointMatrices.size(); j++) {
-			int jointNodeIndex = model.skins[0].joints[j];
+			int jointNodeIndex = model->skins[0].joints[j];
 			skinObject.jointMatrices[j] = nodeTransforms[jointNodeIndex] * skinObject.inverseBindMatrices[j];
 		}
 	}
@@ -287,53 +288,37 @@ void MyBot::update(float time) {
 	// TODO: your code here
 	// -------------------------------------------------
 
-	if (model.animations.empty()) return;
+	if (!model || model->animations.empty()) return;
 
-	const tinygltf::Animation &animation = model.animations[0];
+	const tinygltf::Animation &animation = model->animations[0];
 	const AnimationObject &animationObject = animationObjects[0];
-	std::vector<glm::mat4> nodeTransforms(model.nodes.size(), glm::mat4(1.0f));
+	std::vector<glm::mat4> nodeTransforms(model->nodes.size(), glm::mat4(1.0f));
 
-	updateAnimation(model, animation, animationObject, time, nodeTransforms);
-	computeGlobalNodeTransform(model, nodeTransforms, rootNodeIndex, glm::mat4(1.0f), nodeTransforms);
+	updateAnimation(*model, animation, animationObject, time, nodeTransforms);
+	computeGlobalNodeTransform(*model, nodeTransforms, rootNodeIndex, glm::mat4(1.0f), nodeTransforms);
 	updateSkinning(nodeTransforms);
 }
 
-bool MyBot::loadModel(tinygltf::Model &model, const char *filename) {
-	tinygltf::TinyGLTF loader;
-	std::string err;
-	std::string warn;
-
-	bool res = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
-	if (!warn.empty()) {
-		std::cout << "WARN: " << warn << std::endl;
-	}
-
-	if (!err.empty()) {
-		std::cout << "ERR: " << err << std::endl;
-	}
-
-	if (!res)
-		std::cout << "Failed to load glTF: " << filename << std::endl;
-	else
-		std::cout << "Loaded glTF: " << filename << std::endl;
-
-	return res;
+void MyBot::requestAssets() {
+	AssetManager::instance().requestGltf(MODEL_FILE);
 }
 
 void MyBot::initialize() {
-	// Modify your path if needed
-	if (!loadModel(model, "../FinalProject/assets/model/fox/fox.gltf")){ //"../FinalProject/assets/model/bot/bot.gltf")) {
+	// Modify MODEL_FILE if needed
+	// The model stays shared with the asset manager: animation reads it every frame
+	model = AssetManager::instance().getGltf(MODEL_FILE);
+	if (!model) {
 		return;
 	}
 
 	// Prepare buffers for rendering
-	primitiveObjects = bindModel(model);
+	primitiveObjects = bindModel(*model);
 
 	// Prepare joint matrices
-	skinObjects = prepareSkinning(model);
+	skinObjects = prepareSkinning(*model);
 
 	// Prepare animation data
-	animationObjects = prepareAnimation(model);
+	animationObjects = prepareAnimation(*model);
 
 	// Create and compile our GLSL program from the shaders
 	animationProgramID = LoadShadersFromFile("../FinalProject/shader/bot.vert", "../FinalProject/shader/bot.frag");
@@ -352,11 +337,22 @@ void MyBot::initialize() {
 	glUseProgram(animationProgramID);
 	GLint diffuseTextureLoc = glGetUniformLocation(animationProgramID, "diffuseTexture");
 	glUniform1i(diffuseTextureLoc, 0); // Texture unit 0
+
+	// Skinned variant of the depth shader for the scene shadow map
+	depthProgramID = LoadShadersFromFile("../FinalProject/shader/bot_depth.vert", "../FinalProject/shader/depth.frag");
+	if (depthProgramID == 0)
+	{
+		std::cerr << "Failed to load depth shaders." << std::endl;
+	}
+
+	depthLightSpaceMatrixID = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
+	depthModelMatrixID = glGetUniformLocation(depthProgramID, "Model");
+	depthJointMatricesID = glGetUniformLocation(depthProgramID, "jointMatrices");
 }
 
 
 void MyBot::bindMesh(std::vector<PrimitiveObject> &primitiveObjects,
-                     tinygltf::Model &model, tinygltf::Mesh &mesh) {
+                     const tinygltf::Model &model, const tinygltf::Mesh &mesh) {
 
     std::map<int, GLuint> vbos;
 
@@ -484,8 +480,8 @@ void MyBot::bindMesh(std::vector<PrimitiveObject> &primitiveObjects,
 
 
 void MyBot::bindModelNodes(std::vector<PrimitiveObject> &primitiveObjects,
-					tinygltf::Model &model,
-					tinygltf::Node &node) {
+					const tinygltf::Model &model,
+					const tinygltf::Node &node) {
 	// Bind buffers for the current mesh at the node
 	if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
 		bindMesh(primitiveObjects, model, model.meshes[node.mesh]);
@@ -498,7 +494,7 @@ void MyBot::bindModelNodes(std::vector<PrimitiveObject> &primitiveObjects,
 	}
 }
 
-std::vector<MyBot::PrimitiveObject> MyBot::bindModel(tinygltf::Model &model) {
+std::vector<MyBot::PrimitiveObject> MyBot::bindModel(const tinygltf::Model &model) {
 	std::vector<PrimitiveObject> primitiveObjects;
 
 	const tinygltf::Scene &scene = model.scenes[model.defaultScene];
@@ -511,24 +507,26 @@ std::vector<MyBot::PrimitiveObject> MyBot::bindModel(tinygltf::Model &model) {
 }
 
 void MyBot::drawMesh(const std::vector<PrimitiveObject> &primitiveObjects,
-					tinygltf::Model &model, tinygltf::Mesh &mesh) {
+					const tinygltf::Model &model, const tinygltf::Mesh &mesh, bool depthOnly) {
 
 	for (size_t i = 0; i < mesh.primitives.size(); ++i) {
 		const PrimitiveObject &primitiveObject = primitiveObjects[i];
 		glBindVertexArray(primitiveObject.vao);
 
-		// Bind the diffuse texture
-		if (primitiveObject.textureID != 0) {
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, primitiveObject.textureID);
-		} else {
-			// Bind a default texture or unbind if no texture is present
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
+		if (!depthOnly) {
+			// Bind the diffuse texture
+			if (primitiveObject.textureID != 0) {
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, primitiveObject.textureID);
+			} else {
+				// Bind a default texture or unbind if no texture is present
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
 
-		// Set the sampler uniform to texture unit 0
-		// It's efficient to do this once in initialize, but ensuring it's correct here
-		glUniform1i(glGetUniformLocation(animationProgramID, "diffuseTexture"), 0);
+			// Set the sampler uniform to texture unit 0
+			// It's efficient to do this once in initialize, but ensuring it's correct here
+			glUniform1i(glGetUniformLocation(animationProgramID, "diffuseTexture"), 0);
+		}
 
 		// Bind index buffer and draw
 		const tinygltf::Primitive &primitive = mesh.primitives[i];
@@ -554,21 +552,21 @@ void MyBot::drawMesh(const std::vector<PrimitiveObject> &primitiveObjects,
 
 
 void MyBot::drawModelNodes(const std::vector<PrimitiveObject>& primitiveObjects,
-					tinygltf::Model &model, tinygltf::Node &node) {
+					const tinygltf::Model &model, const tinygltf::Node &node, bool depthOnly) {
 	// Draw the mesh at the node, and recursively do so for children nodes
 	if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
-		drawMesh(primitiveObjects, model, model.meshes[node.mesh]);
+		drawMesh(primitiveObjects, model, model.meshes[node.mesh], depthOnly);
 	}
 	for (size_t i = 0; i < node.children.size(); i++) {
-		drawModelNodes(primitiveObjects, model, model.nodes[node.children[i]]);
+		drawModelNodes(primitiveObjects, model, model.nodes[node.children[i]], depthOnly);
 	}
 }
 void MyBot::drawModel(const std::vector<PrimitiveObject>& primitiveObjects,
-			tinygltf::Model &model) {
+			const tinygltf::Model &model, bool depthOnly) {
 	// Draw all nodes
 	const tinygltf::Scene &scene = model.scenes[model.defaultScene];
 	for (size_t i = 0; i < scene.nodes.size(); ++i) {
-		drawModelNodes(primitiveObjects, model, model.nodes[scene.nodes[i]]);
+		drawModelNodes(primitiveObjects, model, model.nodes[scene.nodes[i]], depthOnly);
 	}
 }
 
@@ -588,9 +586,22 @@ void MyBot::render(glm::mat4& modelMatrix, glm::mat4 cameraMatrix, glm::vec3 lig
 	glUniform3fv(lightIntensityID, 1, glm::value_ptr(lightIntensity));
 
 	// Draw the model
-	drawModel(primitiveObjects, model);
+	drawModel(primitiveObjects, *model);
+}
+
+void MyBot::renderDepth(glm::mat4& modelMatrix, const ShadowMap& shadowMap) {
+	glUseProgram(depthProgramID);
+
+	glUniformMatrix4fv(depthLightSpaceMatrixID, 1, GL_FALSE, glm::value_ptr(shadowMap.getLightSpaceMatrix()));
+	glUniformMatrix4fv(depthModelMatrixID, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+
+	const std::vector<glm::mat4>& jointMatrices = skinObjects[0].jointMatrices;
+	glUniformMatrix4fv(depthJointMatricesID, jointMatrices.size(), GL_FALSE, glm::value_ptr(jointMatrices[0]));
+
+	drawModel(primitiveObjects, *model, true);
 }
 
 void MyBot::cleanup() {
 	glDeleteProgram(animationProgramID);
+	glDeleteProgram(depthProgramID);
 }
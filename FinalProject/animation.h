@@ -4,9 +4,12 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
-#include <tiny_gltf.h>
+#include "AssetManager.h"
+#include <string>
 #include <vector>
 #include <map>
+#include "ShadowMap.h"
+#include "ShadowMap.h"
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
@@ -39,7 +42,13 @@ struct MyBot {
     GLuint lightIntensityID;
     GLuint animationProgramID;
 
-    tinygltf::Model model;
+    // Skinned depth-only program for the scene shadow map
+    GLuint depthProgramID;
+    GLuint depthLightSpaceMatrixID;
+    GLuint depthModelMatrixID;
+    GLuint depthJointMatricesID;
+
+    GltfAsset model;
     std::vector<PrimitiveObject> primitiveObjects;
     std::vector<SkinObject> skinObjects;
     std::vector<AnimationObject> animationObjects;
@@ -57,18 +66,23 @@ struct MyBot {
     void updateSkinning(const std::vector<glm::mat4> &nodeTransforms);
     void update(float time);
 
-    bool loadModel(tinygltf::Model &model, const char *filename);
+    const std::string MODEL_FILE = "../FinalProject/assets/model/fox/fox.gltf"; //"../FinalProject/assets/model/bot/bot.gltf";
+
+    // Start loading the model in the background; initialize waits for it
+    void requestAssets();
     void initialize();
 
-    void bindMesh(std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model, tinygltf::Mesh &mesh);
-    void bindModelNodes(std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model, tinygltf::Node &node);
-    std::vector<PrimitiveObject> bindModel(tinygltf::Model &model);
+    void bindMesh(std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, const tinygltf::Mesh &mesh);
+    void bindModelNodes(std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, const tinygltf::Node &node);
+    std::vector<PrimitiveObject> bindModel(const tinygltf::Model &model);
 
-    void drawMesh(const std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model, tinygltf::Mesh &mesh);
-    void drawModelNodes(const std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model, tinygltf::Node &node);
-    void drawModel(const std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model);
+    void drawMesh(const std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, const tinygltf::Mesh &mesh, bool depthOnly = false);
+    void drawModelNodes(const std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, const tinygltf::Node &node, bool depthOnly = false);
+    void drawModel(const std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, bool depthOnly = false);
 
     void render(glm::mat4& modelMatrix, glm::mat4 cameraMatrix, glm::vec3 lightPosition, glm::vec3 lightIntensity);
+    // Binds its own skinned depth program, so it leaves the shadow map's program unbound
+    void renderDepth(glm::mat4& modelMatrix, const ShadowMap& shadowMap);
     void cleanup();
 };
 
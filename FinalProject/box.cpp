@@ -69,6 +69,7 @@ void Box::initialize(glm::vec3 position, glm::vec3 scale) {
 
 void Box::render(glm::mat4 cameraMatrix) {
 	glUseProgram(programID);
+	glBindVertexArray(vertexArrayID);
 
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
@@ -115,6 +116,7 @@ void Box::render(glm::mat4 cameraMatrix) {
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
     glDisableVertexAttribArray(2);
+	glBindVertexArray(0);
 }
 
 void Box::cleanup() {
@@ -4,31 +4,40 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include "glad/gl.h"
-#include <tiny_gltf.h>
 
+// A glTF primitive ready to draw. Its VAO records the vertex attributes, the index buffer and the
+// instance matrices, so drawing it needs no lookups in the glTF model.
+struct PreparedPrimitive {
+    GLuint vertexArrayID = 0;
+    GLuint textureID = 0;      // Base color, 0 if the material has none
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    size_t indexOffset = 0;    // In bytes, into the index buffer
+};
+
+// What stays of a glTF model once it is on the GPU: the objects to draw and delete, not the source
 struct GltfRenderData {
-    tinygltf::Model model;
     std::vector<GLuint> bufferIDs;
     std::vector<GLuint> textureIDs;
+    std::vector<PreparedPrimitive> primitives;
 };
 
 class City {
 public:
     void setModelMatrix(glm::vec3 position, float size = 1, float rotation = 0, glm::vec3 rotationAxis = glm::vec3(0, 0, 1));
     void updatePosition(glm::vec3 position);
-    void render(glm::mat4& vp, glm::vec3& lightDirection, glm::vec3& lightIntensity, glm::vec3& cameraPos);
-    void drawModel();
     void cleanup();
     void move();
 
+    // Draw the model instanceCount times, with one glDrawElementsInstanced per primitive. The bound
+    // program reads each instance's model matrix at attributes 3 to 6, from the buffer the
+    // primitives' VAOs were prepared with.
+    static void drawInstanced(const GltfRenderData& renderData, GLsizei instanceCount, bool depthOnly = false);
+
     glm::vec3 position = glm::vec3(0,0,0);
     glm::mat4 modelMatrix = glm::mat4(1.0f);
     glm::mat4 rotationScaleMatrix = glm::mat4(1.0f);
 
-    GltfRenderData* renderData = nullptr;
-
-    static GLuint programID;
-
     float yOffset = 0;
     bool up = true;
     float offsetLength = 0.05;
@@ -4,7 +4,7 @@
 #include <cassert>
 #include <fstream>
 #include <render/shader.h>
-#include <tiny_gltf.h>
+#include "AssetManager.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -13,29 +13,6 @@ std::unordered_map<std::string, std::shared_ptr<Model::ModelData>> Model::s_mode
 
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
-bool Model::loadModel(tinygltf::Model &model, const std::string &filename) {
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-
-    bool res = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
-    if (!warn.empty()) {
-        std::cerr << "WARN: " << warn << std::endl;
-    }
-
-    if (!err.empty()) {
-        std::cerr << "ERR: " << err << std::endl;
-    }
-
-    if (!res) {
-        std::cerr << "Failed to load glTF: " << filename << std::endl;
-    } else {
-        std::cout << "Loaded glTF: " << filename << std::endl;
-    }
-
-    return res;
-}
-
 void Model::initialize(const std::string &filename,
                        float xpos, float ypos, float zpos,
                        float size, float rotation, glm::vec3 rotationAxis) {
@@ -48,11 +25,12 @@ void Model::initialize(const std::string &filename,
         // Load the model for the first time
         m_sharedData = std::make_shared<ModelData>();
 
-        if (!loadModel(m_sharedData->m_model, filename)) {
+        m_sharedData->m_model = AssetManager::instance().getGltf(filename);
+        if (!m_sharedData->m_model) {
             return;
         }
 
-        m_sharedData->m_primitiveObjects = bindModel(m_sharedData->m_model);
+        m_sharedData->m_primitiveObjects = bindModel(*m_sharedData->m_model);
 
         m_sharedData->m_programID = LoadShadersFromFile("../FinalProject/shader/model.vert", "../FinalProject/shader/model.frag");
         if (m_sharedData->m_programID == 0) {
@@ -77,17 +55,17 @@ void Model::initialize(const std::string &filename,
     m_modelMatrix = glm::scale(m_modelMatrix, glm::vec3(size, size, size));
 }
 
-std::vector<Model::PrimitiveObject> Model::bindModel(tinygltf::Model &model) {
+std::vector<Model::PrimitiveObject> Model::bindModel(const tinygltf::Model &model) {
     std::vector<PrimitiveObject> primitiveObjects;
 
-    for (tinygltf::Mesh &mesh : model.meshes) {
+    for (const tinygltf::Mesh &mesh : model.meshes) {
         bindMesh(primitiveObjects, model, mesh);
     }
 
     return primitiveObjects;
 }
 
-void Model::bindMesh(std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model, tinygltf::Mesh &mesh) {
+void Model::bindMesh(std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model, const tinygltf::Mesh &mesh) {
     std::map<int, GLuint> vbos;
     GLuint textureID = 0;
 
@@ -182,7 +160,7 @@ void Model::bindMesh(std::vector<PrimitiveObject> &primitiveObjects, tinygltf::M
     }
 }
 
-void Model::drawModel(const std::vector<PrimitiveObject> &primitiveObjects, tinygltf::Model &model) {
+void Model::drawModel(const std::vector<PrimitiveObject> &primitiveObjects, const tinygltf::Model &model) {
     for (size_t i = 0; i < primitiveObjects.size(); ++i) {
         const auto &primitiveObject = primitiveObjects[i];
         glBindVertexArray(primitiveObject.vao);
@@ -224,7 +202,9 @@ void Model::render(const glm::mat4 &cameraMatrix,
     glUniform3fv(m_sharedData->m_lightPositionID, 1, glm::value_ptr(lightPosition));
     glUniform3fv(m_sharedData->m_lightIntensityID, 1, glm::value_ptr(lightIntensity));
 
-    drawModel(m_sharedData->m_primitiveObjects, m_sharedData->m_model);
+    if (m_sharedData->m_model) {
+        drawModel(m_sharedData->m_primitiveObjects, *m_sharedData->m_model);
+    }
 }
 
 void Model::cleanup() {
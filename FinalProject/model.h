@@ -3,7 +3,7 @@
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
-#include <tiny_gltf.h>
+#include "AssetManager.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -27,7 +27,7 @@ public:
 private:
     // Shared model data structure
     struct ModelData {
-        tinygltf::Model m_model;
+        GltfAsset m_model;   // Shared with the asset manager, drawModel walks its nodes
         std::vector<PrimitiveObject> m_primitiveObjects;
         GLuint m_programID;
         GLuint m_mvpMatrixID;
@@ -51,17 +51,16 @@ private:
     glm::mat4 m_modelMatrix;
 
     // Helper functions
-    bool loadModel(tinygltf::Model &model, const std::string &filename);
-    std::vector<PrimitiveObject> bindModel(tinygltf::Model &model);
+    std::vector<PrimitiveObject> bindModel(const tinygltf::Model &model);
     void bindModelNodes(std::vector<PrimitiveObject> &primitiveObjects,
-                        tinygltf::Model &model,
-                        tinygltf::Node &node);
+                        const tinygltf::Model &model,
+                        const tinygltf::Node &node);
     void bindMesh(std::vector<PrimitiveObject> &primitiveObjects,
-                  tinygltf::Model &model,
-                  tinygltf::Mesh &mesh);
+                  const tinygltf::Model &model,
+                  const tinygltf::Mesh &mesh);
 
     void drawModel(const std::vector<PrimitiveObject> &primitiveObjects,
-                   tinygltf::Model &model);
+                   const tinygltf::Model &model);
 };
 
 #endif // MODEL_H
@@ -14,10 +14,15 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
 #include <render/shader.h>
 
 #include "CityManager.h"
 #include "FoxManager.h"
+#include "JobSystem.h"
+#include "CascadedShadowMap.h"
+#include "TerrainNoise.h"
+#include "TerrainConfig.h"
 
 
 #define _USE_MATH_DEFINES
@@ -30,7 +35,6 @@ static int windowHeight = 768;
 static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
-void updateLightSpaceMatrix();
 
 // Camera
 static glm::vec3 eye_center(0, 100, 100);
@@ -54,17 +58,17 @@ static glm::vec3 lightIntensity(5e6f, 5e6f, 5e6f);
 
 static glm::vec3 lightDirection = glm::normalize(glm::vec3(-275.0f, -275.0f, -275.0f)); // Example direction
 
-// Shadow mapping
-static glm::vec3 lightUp(0.0f, 1.0f, 0.0f);
-static int shadowMapWidth = 2048;
-static int shadowMapHeight = 1536;
+// Shadow mapping: one cascade per entry, near to far, out to where the terrain fog ends
+static const int shadowCascadeResolutions[] = { 2048, 2048, 1024, 1024 };
+static float shadowDistance = 2000.0f;
 
-glm::mat4 lightSpaceMatrix;
+// Terrain settings, changed at runtime with the hotkeys and applied at the start of the next frame
+static TerrainConfig terrainConfig;
+static bool terrainConfigChanged = false;
 
-// Define light's orthographic projection parameters
-float near_plane = 0.1f, far_plane = 400.0f;
-float orthoSize = 150.0f; // should be slightly larger than half the terrain size
-glm::mat4 lightProjection = glm::ortho(-orthoSize, orthoSize, -orthoSize, orthoSize, near_plane, far_plane);
+// Chunk sizes cycled through with - and =. Every LOD step divides all of them; only 100 is too
+// small for the coarsest level's edge bands, so it draws with one level fewer.
+static const int terrainChunkSizes[] = { 100, 200, 500, 1000 };
 
 // Animation 
 static bool playAnimation = false;
@@ -138,6 +142,7 @@ struct AxisXYZ {
 
 	void render(glm::mat4 cameraMatrix) {
 		glUseProgram(programID);
+		glBindVertexArray(vertexArrayID);
 
 		glEnableVertexAttribArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
@@ -156,6 +161,7 @@ struct AxisXYZ {
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
+		glBindVertexArray(0);
 	}
 
 	void cleanup() {
@@ -166,8 +172,12 @@ struct AxisXYZ {
 	}
 };
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Terrain settings: the default config file, then the command line on top of it
+	terrainConfig.loadFile(TERRAIN_CONFIG_FILE);
+	terrainConfig.parseArguments(argc, argv);
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
@@ -221,7 +231,14 @@ int main(void)
 	//MyBot bot;
 	//bot.initialize();
 
+	// Start every glTF load before waiting on any, so they run side by side on the workers: the fox
+	// first, as it is initialized first, then the city models, the largest files, which load while
+	// everything before cityManager.initialize is set up
 	FoxManager foxManager;
+	foxManager.requestAssets();
+	CityManager cityManager;
+	cityManager.requestAssets();
+
 	foxManager.initialize();
 
 	AxisXYZ axis;
@@ -231,10 +248,15 @@ int main(void)
 	sky.initialize(glm::vec3(0,-5,0), glm::vec3(100.f,100.0f,100.0f));
 
 	TerrainManager terrainM;
-	terrainM.initialize(eye_center);
+	terrainM.setProjection(glm::radians(FoV), windowHeight);
+	terrainM.initialize(eye_center, terrainConfig);
 
-	CityManager cityManager;
-	cityManager.initialize(30);
+	cityManager.initialize(30, terrainM);
+
+	// Cascaded shadow maps shared by every caster and receiver in the scene
+	CascadedShadowMap shadowMaps;
+	const int cascadeCount = sizeof(shadowCascadeResolutions) / sizeof(shadowCascadeResolutions[0]);
+	shadowMaps.initialize(std::vector<int>(shadowCascadeResolutions, shadowCascadeResolutions + cascadeCount), shadowDistance);
 
 	// -------------------------------------
 	// -------------------------------------
@@ -242,14 +264,20 @@ int main(void)
 	glm::mat4 viewMatrix, projectionMatrix;
 	projectionMatrix = glm::perspective(glm::radians(FoV), (float)windowWidth / windowHeight, zNear, zFar);
 
-	updateLightSpaceMatrix();
-
 	// Time and frame rate tracking
 	static double lastTime = glfwGetTime();
 	float time = 0.0f;			// Animation time 
+	bool animationWasPlaying = false;	// playAnimation in the previous frame
 	float fTime = 0.0f;			// Time for measuring fps
 	unsigned long frames = 0;
 
+	// Startup milestones, in seconds since glfwInit
+	bool firstFrameShown = false;
+	bool fullDetailReached = false;
+
+	// Report the cost of the terrain settings once their chunks are done streaming
+	bool terrainCostReported = false;
+
 	// Main loop
 	do
 	{
@@ -262,7 +290,7 @@ int main(void)
 
 		if (playAnimation) {
 			time += deltaTime * playbackSpeed;
-			foxManager.update(time);
+			foxManager.update(time, terrainM);
 		}
 
 		// Rendering
@@ -271,9 +299,39 @@ int main(void)
 
 		glm::mat4 vp_skybox = projectionMatrix * glm::mat4(glm::mat3(viewMatrix));
 
-		const float lightDistance = 200.0f; // Adjust as needed
-		const float fixedLightY = 10.0f; // Example value, adjust based on your scene
-		glm::vec3 lightPos = glm::vec3(eye_center.x, fixedLightY, eye_center.z) - lightDirection * lightDistance;
+		if (terrainConfigChanged) {
+			terrainConfigChanged = false;
+			terrainM.applyConfig(terrainConfig, eye_center);
+			terrainConfig = terrainM.getConfig();
+			terrainCostReported = false;
+			frames = 0;
+			fTime = 0;
+		}
+
+		// Stream terrain before the shadow pass so both passes see the same chunks
+		if (terrainM.update(eye_center, deltaTime)) shadowMaps.invalidate();
+		if (cityManager.update(eye_center)) shadowMaps.invalidate();
+		// The fox moves while it plays and vanishes when stopped; either way its shadow must be redrawn
+		if (playAnimation || animationWasPlaying) shadowMaps.invalidate();
+		animationWasPlaying = playAnimation;
+
+		// Shadow pass: refit the cascades to the view and redraw only the ones that moved
+		bool shadowsRedrawn = shadowMaps.update(eye_center, lookat - eye_center, glm::radians(FoV),
+			(float)windowWidth / windowHeight, lightDirection,
+			[&](const ShadowMap& cascade) {
+				terrainM.renderDepth(cascade);
+				cityManager.renderDepth(cascade);
+				// The fox binds its own skinned depth program, so it goes last
+				if (playAnimation) {
+					foxManager.renderDepth(cascade);
+				}
+			});
+
+		if (shadowsRedrawn) {
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			glViewport(0, 0, framebufferWidth, framebufferHeight);
+		}
 
 		// View Mesh
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -293,7 +351,7 @@ int main(void)
 
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		terrainM.render(vp, lightSpaceMatrix, lightDirection, lightIntensity, eye_center);
+		terrainM.render(vp, lightDirection, lightIntensity, eye_center, shadowMaps);
 		cityManager.render(vp,lightDirection, lightIntensity, eye_center);
 		glDisable(GL_BLEND);
 
@@ -307,9 +365,37 @@ int main(void)
 			float fps = frames / fTime;
 			frames = 0;
 			fTime = 0;
+
+			TerrainMemoryStats terrainMemory = terrainM.getMemoryStats();
+			const double MB = 1024.0 * 1024.0;
+			double terrainMB = terrainMemory.gpuBytes() / MB;
+			if (!terrainCostReported && terrainM.getPendingChunkCount() == 0) {
+				terrainCostReported = true;
+				std::cout << "Terrain " << terrainM.getConfig().describe() << ": " << std::fixed << std::setprecision(2)
+						  << 1000.0f / fps << " ms/frame, " << terrainMB << " MB on the GPU ("
+						  << terrainMemory.vertexBytes / (1024.0 * 1024.0) << " MB vertices, "
+						  << terrainMemory.gridBytes / (1024.0 * 1024.0) << " MB index, "
+						  << terrainMemory.stagingBytes / (1024.0 * 1024.0) << " MB staging), "
+						  << terrainMemory.cpuBytes() / MB << " MB on the CPU (" << terrainMemory.heightfieldBytes / MB << " MB heights, "
+						  << terrainMemory.prefetchBytes / MB << " MB prefetched, " << terrainMemory.jobBytes / MB << " MB jobs)" << std::endl;
+				std::cout.unsetf(std::ios::floatfield);
+			}
 			
+			// Terrain streaming load on the worker pool since the last title update
+			JobStats jobStats = JobSystem::instance().getStats(true);
+
 			std::stringstream stream;
-			stream << std::fixed << std::setprecision(2) << "Toward a Futuristic Emerald Isle | FPS: " << fps;
+			stream << std::fixed << std::setprecision(2) << "Toward a Futuristic Emerald Isle | FPS: " << fps
+				   << " (" << 1000.0f / fps << "ms)"
+				   << " | Terrain: " << terrainM.getConfig().describe()
+				   << " | Memory: GPU " << terrainMB << "/" << terrainMemory.gpuBudget / MB << "MB"
+				   << ", CPU " << terrainMemory.cpuBytes() / MB << "/" << terrainMemory.cpuBudget / MB << "MB"
+				   << " | Terrain tris: " << terrainM.getCullStats().drawnTriangles << "/" << terrainM.getTriangleCount()
+				   << " | Chunks drawn: " << terrainM.getCullStats().drawn << " (culled " << terrainM.getCullStats().frustumCulled
+				   << " frustum, " << terrainM.getCullStats().fogCulled << " fog)"
+				   << " | Chunks pending: " << terrainM.getPendingChunkCount()
+				   << " | Jobs queued: " << jobStats.queueDepth
+				   << " latency: " << jobStats.averageLatencyMs << "ms (max " << jobStats.maxLatencyMs << "ms)";
 			glfwSetWindowTitle(window, stream.str().c_str());
 		}
 
@@ -317,6 +403,15 @@ int main(void)
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 
+		if (!firstFrameShown) {
+			firstFrameShown = true;
+			std::cout << "Time to first frame: " << glfwGetTime() << "s" << std::endl;
+		}
+		if (!fullDetailReached && terrainM.getPendingChunkCount() == 0) {
+			fullDetailReached = true;
+			std::cout << "Time to full terrain detail: " << glfwGetTime() << "s" << std::endl;
+		}
+
 	} // Check if the ESC key was pressed or the window was closed
 	while (!glfwWindowShouldClose(window));
 
@@ -326,6 +421,7 @@ int main(void)
 	sky.cleanup();
 	terrainM.cleanup();
 	cityManager.cleanup();
+	shadowMaps.cleanup();
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
@@ -356,28 +452,24 @@ static void key_callback(GLFWwindow *window, int key, int scancode, int action,
 		glm::vec3 viewDirection = glm::normalize(lookat - eye_center);
 		eye_center += viewDirection * moveSpeed;
 		lookat += viewDirection * moveSpeed;
-		updateLightSpaceMatrix();
 	}
 
 	if (key == GLFW_KEY_S && (action == GLFW_REPEAT || action == GLFW_PRESS)) {
 		glm::vec3 viewDirection = glm::normalize(lookat - eye_center);
 		eye_center -= viewDirection * moveSpeed;
 		lookat -= viewDirection * moveSpeed;
-		updateLightSpaceMatrix();
 	}
 
 	if (key == GLFW_KEY_A && (action == GLFW_REPEAT || action == GLFW_PRESS)) {
 		glm::vec3 direction = glm::normalize(glm::cross(glm::normalize(lookat - eye_center), up));
 		eye_center -= direction * moveSpeed;
 		lookat -= direction * moveSpeed;
-		updateLightSpaceMatrix();
 	}
 
 	if (key == GLFW_KEY_D && (action == GLFW_REPEAT || action == GLFW_PRESS)) {
 		glm::vec3 direction = glm::normalize(glm::cross(glm::normalize(lookat - eye_center), up));
 		eye_center += direction * moveSpeed;
 		lookat += direction * moveSpeed;
-		updateLightSpaceMatrix();
 	}
 
 	if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
@@ -400,7 +492,41 @@ static void key_callback(GLFWwindow *window, int key, int scancode, int action,
 		eye_center = glm::vec3(100.0f, 100.0f, 100.0f);
 		lookat =  glm::vec3(0,0,0);
 		std::cout << "Camera Reset." << std::endl;
-		updateLightSpaceMatrix();
+	}
+
+	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		// Time terrain noise generation for one chunk on each instruction set
+		benchmarkFbmNoise(terrainConfig.chunkSize, terrainConfig.chunkSize);
+	}
+
+	// Terrain tuning: [ ] view distance, - = chunk size, , . allowed screen-space error
+	if (key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS) {
+		terrainConfig.viewDistance = std::max(terrainConfig.viewDistance - 1, 1);
+		terrainConfigChanged = true;
+	}
+
+	if (key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS) {
+		terrainConfig.viewDistance += 1;
+		terrainConfigChanged = true;
+	}
+
+	if ((key == GLFW_KEY_MINUS || key == GLFW_KEY_EQUAL) && action == GLFW_PRESS) {
+		const int count = sizeof(terrainChunkSizes) / sizeof(terrainChunkSizes[0]);
+		int index = 0;
+		while (index < count - 1 && terrainChunkSizes[index] < terrainConfig.chunkSize) index++;
+		index += key == GLFW_KEY_EQUAL ? 1 : -1;
+		terrainConfig.chunkSize = terrainChunkSizes[std::min(std::max(index, 0), count - 1)];
+		terrainConfigChanged = true;
+	}
+
+	if (key == GLFW_KEY_COMMA && action == GLFW_PRESS) {
+		terrainConfig.maxScreenError *= 0.5f;
+		terrainConfigChanged = true;
+	}
+
+	if (key == GLFW_KEY_PERIOD && action == GLFW_PRESS) {
+		terrainConfig.maxScreenError *= 2.0f;
+		terrainConfigChanged = true;
 	}
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
@@ -439,11 +565,3 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
 
 	lookat = eye_center + viewDirection;
 }
-
-void updateLightSpaceMatrix() {
-	const float lightDistance = 200.0f; // Adjust as needed
-	const float fixedLightY = 10.0f; // Example value, adjust based on your scene
-	glm::vec3 lightPos = glm::vec3(eye_center.x, fixedLightY, eye_center.z) - lightDirection * lightDistance;
-	glm::mat4 lightView = glm::lookAt(lightPos, glm::vec3(eye_center.x, 0.0f, eye_center.z), lightUp);
-	lightSpaceMatrix = lightProjection * lightView;
-}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+
+// Input
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 3) in vec4 vertexJoint;
+layout(location = 4) in vec4 vertexWeight;
+
+uniform mat4 lightSpaceMatrix;
+uniform mat4 Model;
+uniform mat4 jointMatrices[25];
+
+void main() {
+    mat4 skinMatrix =   vertexWeight.x * jointMatrices[int(vertexJoint.x)] +
+                        vertexWeight.y * jointMatrices[int(vertexJoint.y)] +
+                        vertexWeight.z * jointMatrices[int(vertexJoint.z)] +
+                        vertexWeight.w * jointMatrices[int(vertexJoint.w)];
+
+    gl_Position = lightSpaceMatrix * Model * skinMatrix * vec4(vertexPosition, 1.0);
+}
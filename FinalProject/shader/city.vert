@@ -0,0 +1,24 @@
+#version 330 core
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexNormal;
+layout(location = 2) in vec2 vertexUV;
+
+// One model matrix per city, from the instance buffer; takes locations 3 to 6
+layout(location = 3) in mat4 instanceModel;
+
+uniform mat4 VP;
+
+out vec3 fragNormal;
+out vec3 fragPosition;
+out vec2 fragTexCoord;
+
+void main() {
+    vec4 worldPosition = instanceModel * vec4(vertexPosition, 1.0);
+    gl_Position = VP * worldPosition;
+    fragPosition = worldPosition.xyz;
+
+    // Cities are only rotated and uniformly scaled, so the model matrix transforms normals too
+    fragNormal = normalize(mat3(instanceModel) * vertexNormal);
+    fragTexCoord = vertexUV;
+}
@@ -4,13 +4,19 @@ in vec2 uv;
 in vec3 fragPos;
 in vec3 normal;
 
+// Must match MAX_SHADOW_CASCADES in CascadedShadowMap.h
+#define MAX_CASCADES 4
+
 uniform sampler2D textureSampler;
-uniform sampler2D depthTextureSampler;
 uniform vec3 lightDirection;
 uniform vec3 lightIntensity;
 uniform vec3 cameraPos;
 
-uniform mat4 lightSpaceMatrixRender;
+// Shadow cascades, ordered near to far
+uniform sampler2D shadowMaps[MAX_CASCADES];
+uniform mat4 lightSpaceMatrices[MAX_CASCADES];
+uniform vec2 shadowMapSizes[MAX_CASCADES];
+uniform int cascadeCount;
 
 const float gamma = 2.2;
 const float bias = 1e-3;
@@ -21,6 +27,43 @@ const vec3 fogColor = vec3(0.71, 0.72, 0.73); // Gray fog
 
 out vec4 finalColor;
 
+// GLSL 3.30 only allows constant indices into sampler arrays
+float sampleShadowMap(int cascade, vec2 uv) {
+    if (cascade == 0) return texture(shadowMaps[0], uv).r;
+    if (cascade == 1) return texture(shadowMaps[1], uv).r;
+    if (cascade == 2) return texture(shadowMaps[2], uv).r;
+    return texture(shadowMaps[3], uv).r;
+}
+
+// Fraction of light reaching fragPos, using the finest cascade that contains it
+float computeShadow() {
+    for (int cascade = 0; cascade < cascadeCount; ++cascade) {
+        vec4 lightSpacePosition = lightSpaceMatrices[cascade] * vec4(fragPos, 1.0);
+        vec3 lightSpaceNDC = lightSpacePosition.xyz / lightSpacePosition.w;
+        vec3 lightSpace0to1 = (lightSpaceNDC * 0.5) + 0.5;
+        if(any(lessThan(lightSpace0to1, vec3(0.01))) || any(greaterThan(lightSpace0to1, vec3(0.99)))) continue;
+
+        vec2 shadowUV = lightSpace0to1.xy;
+        float depth = lightSpace0to1.z;
+
+        // Percentage-Closer Filtering (PCF)
+        float shadow = 0.0;
+        vec2 texelSize = 1.0 / shadowMapSizes[cascade];
+        for(int x = -PCF_SIZE; x <= PCF_SIZE; ++x) {
+            for(int y = -PCF_SIZE; y <= PCF_SIZE; ++y) {
+                vec2 offset = vec2(float(x), float(y)) * texelSize;
+                float existingDepth = sampleShadowMap(cascade, shadowUV + offset);
+                if(depth < existingDepth + bias) shadow += 1.0;
+            }
+        }
+        int totalSamples = (2 * PCF_SIZE + 1) * (2 * PCF_SIZE + 1);
+        return shadow / float(totalSamples);
+    }
+
+    // Outside every cascade
+    return 1.0;
+}
+
 void main()
 {
     // --- Fog Calculation ---
@@ -40,26 +83,7 @@ void main()
     }
 
     // shadow mapping
-    vec4 lightSpacePosition = lightSpaceMatrixRender * vec4(fragPos, 1.0);
-    vec3 lightSpaceNDC = lightSpacePosition.xyz / lightSpacePosition.w;
-    vec3 lightSpace0to1 = (lightSpaceNDC * 0.5) + 0.5;
-    vec2 shadowUV = lightSpace0to1.xy;
-    float depth = lightSpace0to1.z;
-
-    // Percentage-Closer Filtering (PCF)
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / vec2(2048,1536); // TODO: pass depth map size
-    for(int x = -PCF_SIZE; x <= PCF_SIZE; ++x) {
-        for(int y = -PCF_SIZE; y <= PCF_SIZE; ++y) {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            float existingDepth = texture(depthTextureSampler, shadowUV + offset).r;
-            if(depth < existingDepth + bias) shadow += 1.0;
-        }
-    }
-    int totalSamples = (2 * PCF_SIZE + 1) * (2 * PCF_SIZE + 1);
-    shadow /= float(totalSamples);
-
-    if(any(lessThan(lightSpace0to1, vec3(0.01))) || any(greaterThan(lightSpace0to1, vec3(0.99)))) shadow = 1.0;
+    float shadow = computeShadow();
 
     // lighting, tone mapping, gamma correction
     float theta = max(dot(normal, -lightDirection), 0.0);
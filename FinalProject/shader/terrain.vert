@@ -1,9 +1,8 @@
 #version 330 core
 
-// Input
-layout(location = 0) in vec3 vertexPosition;
-layout(location = 2) in vec2 vertexUV;
-layout(location = 3) in vec3 vertexNormal;
+// Input: a quantized height and an octahedral normal per vertex; x and z come from the grid
+layout(location = 0) in float vertexHeight;
+layout(location = 3) in vec2 vertexNormal;
 
 out vec2 uv;
 out vec3 fragPos;
@@ -13,16 +12,38 @@ out vec3 normal;
 uniform mat4 MVP;
 uniform mat4 Model;
 
+// Chunk grid placement. All chunks share one vertex buffer with a fixed number of vertices per chunk,
+// and gl_VertexID includes the draw's base vertex, so it also tells which chunk a vertex belongs to.
+uniform samplerBuffer chunkOrigins; // World x and z of each chunk's vertex 0
+uniform int verticesPerChunk;
+uniform int gridWidth;      // Quads per row, so a row holds gridWidth + 1 vertices
+uniform float heightRange;  // Heights are stored over [-heightRange, heightRange]
+uniform vec2 uvScale;       // Texture repeats per grid step
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
+    int chunk = gl_VertexID / verticesPerChunk;
+    int vertex = gl_VertexID - chunk * verticesPerChunk;
+    vec2 chunkOrigin = texelFetch(chunkOrigins, chunk).xy;
+
+    vec2 gridPos = vec2(vertex % (gridWidth + 1), vertex / (gridWidth + 1));
+    float height = (vertexHeight / 65535.0 * 2.0 - 1.0) * heightRange;
+    vec3 vertexPosition = vec3(chunkOrigin.x + gridPos.x, height, chunkOrigin.y + gridPos.y);
+
     gl_Position =  MVP * vec4(vertexPosition, 1);
 
-    uv = vertexUV;
+    uv = gridPos * uvScale;
 
     // Calculate world position of the fragment
     fragPos = vec3(Model * vec4(vertexPosition, 1.0));
-    //fragPos = vertexPosition;
 
     // Transform the normal vector to world space
-    normal = mat3(transpose(inverse(Model))) * vertexNormal;
-    //normal = vertexNormal;
+    normal = mat3(transpose(inverse(Model))) * decodeOctahedral(vertexNormal / 127.0);
 }
@@ -0,0 +1,21 @@
+#version 330 core
+
+// Same packed input as terrain.vert, positions only
+layout(location = 0) in float vertexHeight;
+
+uniform mat4 lightSpaceMatrix;
+
+uniform samplerBuffer chunkOrigins;
+uniform int verticesPerChunk;
+uniform int gridWidth;
+uniform float heightRange;
+
+void main() {
+    int chunk = gl_VertexID / verticesPerChunk;
+    int vertex = gl_VertexID - chunk * verticesPerChunk;
+    vec2 chunkOrigin = texelFetch(chunkOrigins, chunk).xy;
+
+    vec2 gridPos = vec2(vertex % (gridWidth + 1), vertex / (gridWidth + 1));
+    float height = (vertexHeight / 65535.0 * 2.0 - 1.0) * heightRange;
+    gl_Position = lightSpaceMatrix * vec4(chunkOrigin.x + gridPos.x, height, chunkOrigin.y + gridPos.y, 1);
+}
@@ -60,6 +60,7 @@ void Sky::initialize(glm::vec3 position, glm::vec3 scale) {
 
 void Sky::render(glm::mat4 cameraMatrix) {
 	glUseProgram(programID);
+	glBindVertexArray(vertexArrayID);
 
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
@@ -103,6 +104,7 @@ void Sky::render(glm::mat4 cameraMatrix) {
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
     //glDisableVertexAttribArray(2);
+	glBindVertexArray(0);
 }
 
 void Sky::cleanup() {
@@ -2,316 +2,333 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
-#include <utils.h>
-#include <stb_image_write.h>
 #include <future>
 #include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include "TerrainNoiseGraph.h"
+#include "TerrainHeightfield.h"
+#include "TerrainCache.h"
+
+// For each level, the largest vertical distance between a full-resolution vertex and the
+// coarse triangle covering it. Coarse cells are split along the same diagonal as the index buffer.
+// heights points at the chunk's first vertex inside a buffer with rows of stride floats.
+static void computeLodErrors(const float* heights, int stride, int width, int depth,
+                             float errors[TERRAIN_LOD_LEVELS]) {
+    float previousError = 0.0f;
+    for (int level = 0; level < TERRAIN_LOD_LEVELS; ++level) {
+        if (!isTerrainLodUsable(level, width, depth)) {
+            errors[level] = std::numeric_limits<float>::max();
+            continue;
+        }
 
-#define STB_PERLIN_IMPLEMENTATION
-#include "stb_perlin.h"
+        const int step = TERRAIN_LOD_STEPS[level];
+        float maxError = 0.0f;
+        for (int z = 0; z <= depth; ++z) {
+            int z0 = std::min(z / step * step, depth - step);
+            float v = static_cast<float>(z - z0) / step;
 
-static int shadowMapWidth = 2048;
-static int shadowMapHeight = 1536;
+            for (int x = 0; x <= width; ++x) {
+                int x0 = std::min(x / step * step, width - step);
+                float u = static_cast<float>(x - x0) / step;
 
-bool saveDepth = false;
+                float h00 = heights[z0 * stride + x0];
+                float h10 = heights[z0 * stride + x0 + step];
+                float h01 = heights[(z0 + step) * stride + x0];
+                float h11 = heights[(z0 + step) * stride + x0 + step];
 
-static void saveDepthTexture(GLuint fbo, std::string filename) {
-    int width = shadowMapWidth;
-    int height = shadowMapHeight;
+                float interpolated = (u + v <= 1.0f)
+                    ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                    : h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
 
-    int channels = 3;
+                maxError = std::max(maxError, std::fabs(heights[z * stride + x] - interpolated));
+            }
+        }
 
-    std::vector<float> depth(width * height);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    //glReadBuffer(GL_DEPTH_COMPONENT);
-    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // Keep the errors monotonic so a coarser level never looks better than a finer one
+        previousError = std::max(previousError, maxError);
+        errors[level] = previousError;
+    }
+}
 
-    std::vector<unsigned char> img(width * height * 3);
-    for (int i = 0; i < width * height; ++i) img[3*i] = img[3*i+1] = img[3*i+2] = depth[i] * 255;
+// Move finished vertices into a mapped staging slot, so the render thread only has to issue a copy
+static void moveToStaging(TerrainData& data, const StagingSlot& staging) {
+    size_t bytes = data.vertexCount() * sizeof(TerrainVertex);
+    if (bytes > staging.capacity) {
+        std::cerr << "Terrain chunk does not fit its staging slot" << std::endl;
+        return;
+    }
 
-    stbi_write_png(filename.c_str(), width, height, channels, img.data(), width * channels);
+    std::memcpy(staging.mapped, data.vertexData(), bytes);
+    data.vertices = std::vector<TerrainVertex>();
+    data.mappedFile.reset();
+    data.mappedVertices = nullptr;
+    data.mappedVertexCount = 0;
+    data.stagingSlot = staging.index;
+    data.stagedBytes = bytes;
 }
 
-std::future<TerrainData> Terrain::generateTerrainAsync(int width, int depth, float maxHeight, float posX, float posZ) {
-    return std::async(std::launch::async, [=]() -> TerrainData {
+std::future<TerrainData> Terrain::generateTerrainAsync(int width, int depth, float maxHeight, float posX, float posZ,
+                                                      CancelToken cancelToken, StagingSlot staging) {
+    TerrainCache* chunkCache = cache;
+    std::shared_ptr<const TerrainNoiseGraph> graph = noiseGraph;
+    if (!graph) graph = TerrainNoiseGraph::createPreset("classic", 0);
+
+    std::function<TerrainData()> generate = [=]() -> TerrainData {
         TerrainData data;
 
+        TerrainCacheKey cacheKey;
+        cacheKey.centerX = static_cast<int>(posX);
+        cacheKey.centerZ = static_cast<int>(posZ);
+        cacheKey.width = width;
+        cacheKey.depth = depth;
+        cacheKey.maxHeight = maxHeight;
+        cacheKey.noiseHash = graph->getHash();
+        if (chunkCache && chunkCache->load(cacheKey, data)) return data;
+
+        data.vertices.reserve((width + 1) * (depth + 1));
+
         // Begin generating vertices and normals
         float halfWidth = width / 2.0f;
         float halfDepth = depth / 2.0f;
+        data.originX = posX - halfWidth;
+        data.originZ = posZ - halfDepth;
+
+        // Heights carry a one-vertex apron around the chunk so border normals see the
+        // neighbouring chunk's terrain, and match it exactly
+        const int apronWidth = width + 3;
+        const int apronDepth = depth + 3;
+        std::vector<float> heights(static_cast<size_t>(apronWidth) * apronDepth);
+
+        // The noise graph, a whole row of samples per call
+        TerrainNoiseGraph::Scratch scratch;
+        for (int z = 0; z < apronDepth; ++z) {
+            // The camera already left this chunk, don't bother finishing it
+            if (isCancelled(cancelToken)) return TerrainData();
+
+            float worldZ = (z - 1) - halfDepth + posZ;
+            float* row = &heights[static_cast<size_t>(z) * apronWidth];
+            graph->evaluateRow(posX - halfWidth - 1.0f, worldZ, apronWidth, row, scratch);
+
+            // Scale the noise value to the desired height range
+            for (int x = 0; x < apronWidth; ++x) {
+                row[x] *= maxHeight;
+            }
+        }
 
-        // Perlin noise parameters
-        float scale = 0.02f; // Controls the frequency of the noise
-        int octaves = 6;     // Number of layers of noise
-        float persistence = 0.4f; // Amplitude multiplier for each octave
-        float lacunarity = 2.0f;  // Frequency multiplier for each octave
-
-
+        // Packed vertices and central-difference normals, one row at a time from three rows of heights.
+        // The grid spacing is one unit, so the normal of y = h(x, z) is (-dh/dx, 1, -dh/dz) scaled by 2.
+        data.minHeight = std::numeric_limits<float>::max();
+        data.maxHeight = -std::numeric_limits<float>::max();
         for (int z = 0; z <= depth; ++z) {
-            for (int x = 0; x <= width; ++x) {
-                float worldX = x - halfWidth + posX;
-                float worldZ = z - halfDepth + posZ;
+            const float* above = &heights[static_cast<size_t>(z) * apronWidth + 1];
+            const float* center = above + apronWidth;
+            const float* below = center + apronWidth;
 
-                float noiseValue = 0.0f;
-                float frequency = scale;
-                float amplitude = 1.0f;
-                float maxAmplitude = 0.0f; // For normalization
-
-                // Generate fractal noise by combining multiple octaves
-                for (int i = 0; i < octaves; ++i) {
-                    float sampleX = worldX * frequency;
-                    float sampleZ = worldZ * frequency;
-
-                    float perlin = stb_perlin_noise3(sampleX, sampleZ, 0.0f, 0, 0, 0);
-                    noiseValue += perlin * amplitude;
-
-                    maxAmplitude += amplitude;
-                    amplitude *= persistence;
-                    frequency *= lacunarity;
-                }
-
-                // Normalize the noise value to range [-1, 1]
-                noiseValue /= maxAmplitude;
-
-                // Scale the noise value to the desired height range
-                float height = noiseValue * maxHeight;
-
-                data.vertices.emplace_back(glm::vec3(worldX, height, worldZ));
+            for (int x = 0; x <= width; ++x) {
+                glm::vec3 normal(center[x - 1] - center[x + 1], 2.0f, above[x] - below[x]);
+                data.vertices.push_back(packVertex(center[x], normal, maxHeight));
+                data.minHeight = std::min(data.minHeight, center[x]);
+                data.maxHeight = std::max(data.maxHeight, center[x]);
             }
         }
 
-        // Initialize normals
-        data.normals.resize(data.vertices.size(), glm::vec3(0.0f, 0.0f, 0.0f));
-
-        // Compute normals
-        for (size_t i = 0; i < indices.size(); i += 3) {
-            GLuint idx0 = indices[i];
-            GLuint idx1 = indices[i + 1];
-            GLuint idx2 = indices[i + 2];
+        computeLodErrors(&heights[apronWidth + 1], apronWidth, width, depth, data.lodErrors);
 
-            glm::vec3 v0 = data.vertices[idx0];
-            glm::vec3 v1 = data.vertices[idx1];
-            glm::vec3 v2 = data.vertices[idx2];
+        if (chunkCache) chunkCache->store(cacheKey, data);
 
-            glm::vec3 edge1 = v1 - v0;
-            glm::vec3 edge2 = v2 - v0;
-
-            glm::vec3 faceNormal = glm::normalize(glm::cross(edge1, edge2));
-
-            data.normals[idx0] += faceNormal;
-            data.normals[idx1] += faceNormal;
-            data.normals[idx2] += faceNormal;
-        }
+        return data;
+    };
 
-        // Normalize the normals
-        for (auto & normal : data.normals) {
-            normal = glm::normalize(normal);
+    std::function<TerrainData()> task = [=]() -> TerrainData {
+        TerrainData data = generate();
+        if (data.vertexCount() > 0) {
+            data.heightfield = TerrainHeightfield::create(data.vertexData(), width, depth,
+                                                          data.originX, data.originZ, maxHeight);
         }
-
+        if (staging.index >= 0 && data.vertexCount() > 0) moveToStaging(data, staging);
         return data;
-    });
-}
-
-void Terrain::updateBuffers(const TerrainData& data) {
-    std::lock_guard<std::mutex> lock(bufferMutex); // Protect buffer updates if accessed from multiple threads
+    };
 
-    // Update vertex buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(glm::vec3), data.vertices.data(), GL_STATIC_DRAW);
-
-    // Update normal buffer
-    glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-    glBufferData(GL_ARRAY_BUFFER, data.normals.size() * sizeof(glm::vec3), data.normals.data(), GL_STATIC_DRAW);
+    return JobSystem::instance().submitTask(task, cancelToken);
 }
 
+TerrainVertex Terrain::packVertex(float height, const glm::vec3& normal, float maxHeight) {
+    TerrainVertex vertex;
 
-void Terrain::setProgramIDs(GLuint inputProgramID, GLuint inputDepthProgramID) {
-    if (programID == 0) programID = inputProgramID;
-    if (depthProgramID == 0) depthProgramID = inputDepthProgramID;
-}
+    float t = glm::clamp((height / maxHeight) * 0.5f + 0.5f, 0.0f, 1.0f);
+    vertex.height = static_cast<GLushort>(t * 65535.0f + 0.5f);
 
-void Terrain::initialize(int width, int depth, float maxHeight, float posX, float posZ) {
-    // Index buffer generation
-    for (int z = 0; z < depth; ++z) {
-        int currentRow = z * (width + 1);
-        int nextRow = (z + 1) * (width + 1);
-
-        for (int x = 0; x < width; ++x) {
-            GLuint topLeft = currentRow + x;
-            GLuint topRight = topLeft + 1;
-            GLuint bottomLeft = nextRow + x;
-            GLuint bottomRight = bottomLeft + 1;
-
-            indices.push_back(topLeft);
-            indices.push_back(bottomLeft);
-            indices.push_back(topRight);
-            indices.push_back(topRight);
-            indices.push_back(bottomLeft);
-            indices.push_back(bottomRight);
-        }
+    // Octahedral encoding around the y axis: project onto |x| + |y| + |z| = 1, then fold the
+    // lower hemisphere over the diagonals. Terrain normals always point up, but keep it general.
+    glm::vec3 n = normal / (std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z));
+    glm::vec2 e(n.x, n.z);
+    if (n.y < 0.0f) {
+        e = glm::vec2((1.0f - std::fabs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f));
     }
+    vertex.normal[0] = static_cast<GLbyte>(std::round(glm::clamp(e.x, -1.0f, 1.0f) * 127.0f));
+    vertex.normal[1] = static_cast<GLbyte>(std::round(glm::clamp(e.y, -1.0f, 1.0f) * 127.0f));
 
-    // UV initialization
-    float tilingFactor = 25.0f;
-    for (int z = 0; z <= depth; ++z) {
-        for (int x = 0; x <= width; ++x) {
-            uvs.emplace_back(glm::vec2(
-                (x / static_cast<float>(width)) * tilingFactor,
-                (z / static_cast<float>(depth)) * tilingFactor
-            ));
-        }
-    }
+    return vertex;
+}
 
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
+void Terrain::updateBuffers(const TerrainData& data) {
+    if (page < 0) return;
+
+    // Overwrite the chunk's page in place
+    const size_t offset = pool->getPageOffset(page);
+    if (data.stagingSlot >= 0 && uploads) {
+        uploads->copyToBuffer(data.stagingSlot, pool->getBufferID(), offset, data.stagedBytes);
+    } else {
+        const size_t bytes = data.vertexCount() * sizeof(TerrainVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, pool->getBufferID());
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data.vertexData());
+        if (uploads) uploads->countUpload(bytes);
+    }
 
-    glGenBuffers(1, &vertexBufferID);
+    // The grid origin moves with the data, not when the chunk is reassigned
+    originX = data.originX;
+    originZ = data.originZ;
+    pool->setOrigin(page, originX, originZ);
 
-    glGenBuffers(1, &normalBufferID);
+    std::copy(data.lodErrors, data.lodErrors + TERRAIN_LOD_LEVELS, geometricErrors);
 
-    std::future<TerrainData> fut = generateTerrainAsync(width, depth, maxHeight, posX, posZ);
-    TerrainData data = fut.get();
-    updateBuffers(data);
+    // Widen by one quantization step, since the shader sees the packed heights
+    const float quantization = 2.0f * maxHeight / 65535.0f;
+    boundsMinY = data.minHeight - quantization;
+    boundsMaxY = data.maxHeight + quantization;
+}
 
-    glGenBuffers(1, &uvBufferID);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), uvs.data(), GL_STATIC_DRAW);
+glm::vec3 Terrain::getBoundsMin() const {
+    return glm::vec3(originX, boundsMinY, originZ);
+}
 
-    glGenBuffers(1, &indexBufferID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+glm::vec3 Terrain::getBoundsMax() const {
+    return glm::vec3(originX + grid->width, boundsMaxY, originZ + grid->depth);
+}
 
-    // Create a fbo
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    // Create a depth texture
-    glGenTextures(1, &depthTexture);
-    glBindTexture(GL_TEXTURE_2D, depthTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadowMapWidth, shadowMapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cout << "Failed to create framebuffer" << std::endl;
-    }
+std::shared_ptr<TerrainGridBuffers> Terrain::createGridBuffers(int width, int depth, float maxHeight) {
+    std::shared_ptr<TerrainGridBuffers> gridBuffers(new TerrainGridBuffers());
+    gridBuffers->width = width;
+    gridBuffers->depth = depth;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Every level's interior and edge bands, back to back, ordered for the post-transform cache
+    std::vector<GLuint> indices;
+    buildTerrainGridIndices(width, depth, terrainStripQuads(TERRAIN_VERTEX_CACHE_SIZE), indices, *gridBuffers);
 
-    if (programID == 0 || depthProgramID == 0) {
-        createTerrainProgramIDs(programID, depthProgramID);
+    if (gridBuffers->levelCount == 0) {
+        std::cerr << "Terrain grid " << width << "x" << depth << " does not fit any LOD step" << std::endl;
     }
 
-    std::string filePath = "../FinalProject/assets/textures/green_grass.jpg";
-    textureID = LoadTextureTileBox(filePath.c_str());
-    textureSamplerID = glGetUniformLocation(programID,"textureSampler");
-
-    // Get a handle for our "MVP" uniform
-    mvpMatrixID = glGetUniformLocation(programID, "MVP");
-    modelMatrixIDRender = glGetUniformLocation(programID, "Model");
-    modelMatrixIDDepth = glGetUniformLocation(depthProgramID, "Model");
-
-    lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
-    lightDirectionID = glGetUniformLocation(programID, "lightDirection");
-    cameraPosID = glGetUniformLocation(programID, "cameraPos");
+    glGenBuffers(1, &gridBuffers->indexBufferID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridBuffers->indexBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
-    lightSpaceMatrixIDRender = glGetUniformLocation(programID, "lightSpaceMatrixRender");
-    lightSpaceMatrixIDDepth = glGetUniformLocation(depthProgramID, "lightSpaceMatrix");
+    std::vector<TerrainVertex> flat(static_cast<size_t>(width + 1) * (depth + 1),
+                                    packVertex(0.0f, glm::vec3(0.0f, 1.0f, 0.0f), maxHeight));
+    glGenBuffers(1, &gridBuffers->placeholderBufferID);
+    glBindBuffer(GL_COPY_READ_BUFFER, gridBuffers->placeholderBufferID);
+    glBufferData(GL_COPY_READ_BUFFER, flat.size() * sizeof(TerrainVertex), flat.data(), GL_STATIC_DRAW);
 
-    depthTextureSamplerID = glGetUniformLocation(programID, "depthTextureSampler");
+    gridBuffers->gpuBytes = indices.size() * sizeof(GLuint) + flat.size() * sizeof(TerrainVertex);
 
-    //std::cout << "Vertices: " << vertices.size() << std::endl;
+    return gridBuffers;
 }
 
-void Terrain::render(glm::mat4 vp, glm::mat4 lightSpaceMatrix, glm::vec3 lightDirection, glm::vec3 lightIntensity, glm::vec3 cameraPos) {
-    glEnableVertexAttribArray(0); // Positions
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glEnableVertexAttribArray(2); // UVs
-    glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glEnableVertexAttribArray(3); // normals
-    glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-    glBindVertexArray(vertexArrayID);
-    glEnableVertexAttribArray(0);
-
-    glm::mat4 model = glm::mat4(1.0f);
-
-    // -------------------
-    // Depth Mapping
-    // -------------------
-    glUseProgram(depthProgramID);
-    glViewport(0, 0, shadowMapWidth, shadowMapHeight);
+void Terrain::deleteGridBuffers(TerrainGridBuffers& gridBuffers) {
+    glDeleteBuffers(1, &gridBuffers.indexBufferID);
+    glDeleteBuffers(1, &gridBuffers.placeholderBufferID);
+    gridBuffers.indexBufferID = 0;
+    gridBuffers.placeholderBufferID = 0;
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void Terrain::initialize(const std::shared_ptr<TerrainGridBuffers>& gridBuffers, TerrainVertexPool* vertexPool,
+                         float maxHeight, float posX, float posZ) {
+    grid = gridBuffers;
+    pool = vertexPool;
+    this->maxHeight = maxHeight;
+    const int width = grid->width;
+    const int depth = grid->depth;
+
+    page = pool->allocate();
+    if (page < 0) {
+        std::cerr << "Terrain vertex pool is full" << std::endl;
+    }
 
-    glUniformMatrix4fv(lightSpaceMatrixIDDepth, 1, GL_FALSE, &lightSpaceMatrix[0][0]);
-    glUniformMatrix4fv(modelMatrixIDDepth, 1, GL_FALSE, &model[0][0]);
+    originX = posX - width / 2.0f;
+    originZ = posZ - depth / 2.0f;
+    std::fill(geometricErrors, geometricErrors + TERRAIN_LOD_LEVELS, 0.0f);
+    boundsMinY = 0.0f;
+    boundsMaxY = 0.0f;
+
+    // Start from the flat tile, copied on the GPU, until TerrainManager streams in the real terrain
+    if (page >= 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, grid->placeholderBufferID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, pool->getBufferID());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, pool->getPageOffset(page), pool->getPageBytes());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        pool->setOrigin(page, originX, originZ);
+    }
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    // -------------------
-    // -------------------
+    // Start at full resolution until TerrainManager picks a level
+    lodLevel = 0;
+    std::fill(stitchedEdges, stitchedEdges + EDGE_COUNT, 0);
+    updateDrawRanges();
+}
 
-    glUseProgram(programID);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, 2*1024, 2*768);
+void Terrain::updateDrawRanges() {
+    const TerrainIndexRange& interior = grid->interior[lodLevel];
+    drawCounts[0] = interior.count;
+    drawOffsets[0] = reinterpret_cast<const void*>(interior.offset);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(textureSamplerID, 0);
+    for (int edge = 0; edge < EDGE_COUNT; ++edge) {
+        const TerrainIndexRange& band = grid->edges[lodLevel][edge][stitchedEdges[edge]];
+        drawCounts[edge + 1] = band.count;
+        drawOffsets[edge + 1] = reinterpret_cast<const void*>(band.offset);
+    }
+}
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, depthTexture);
-    glUniform1i(depthTextureSamplerID, 1);
+bool Terrain::setLod(int level, const int neighbourLevels[EDGE_COUNT]) {
+    level = std::max(0, std::min(level, grid->levelCount - 1));
 
-    glm::mat4 mvp = vp * model;
-    glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-    glUniformMatrix4fv(modelMatrixIDRender, 1, GL_FALSE, &model[0][0]);
+    int stitched[EDGE_COUNT];
+    for (int edge = 0; edge < EDGE_COUNT; ++edge) {
+        stitched[edge] = neighbourLevels[edge] > level && level + 1 < grid->levelCount ? 1 : 0;
+    }
 
-    glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
-    glUniform3fv(lightDirectionID, 1, &lightDirection[0]);
-    glUniformMatrix4fv(lightSpaceMatrixIDRender, 1, GL_FALSE, &lightSpaceMatrix[0][0]);
+    if (level == lodLevel && std::equal(stitched, stitched + EDGE_COUNT, stitchedEdges)) return false;
 
-    glUniform3fv(cameraPosID, 1, &cameraPos[0]);
+    lodLevel = level;
+    std::copy(stitched, stitched + EDGE_COUNT, stitchedEdges);
+    updateDrawRanges();
+    return true;
+}
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+int Terrain::getTriangleCount() const {
+    GLsizei indexCount = 0;
+    for (int i = 0; i <= EDGE_COUNT; ++i) indexCount += drawCounts[i];
+    return indexCount / 3;
+}
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
+void Terrain::appendDraws(TerrainDrawList& draws) const {
+    if (page < 0) return;
 
-    if (saveDepth) {
-        std::string filename = "depth_camera.png";
-        saveDepthTexture(0, filename);
-        std::cout << "Depth texture saved to " << filename << std::endl;
-        filename = "depth_light.png";
-        saveDepthTexture(fbo, filename);
-        std::cout << "Depth texture saved to " << filename << std::endl;
-        saveDepth = false;
+    // Interior block and the four edge bands of the current level
+    const GLint baseVertex = pool->getBaseVertex(page);
+    for (int i = 0; i <= EDGE_COUNT; ++i) {
+        draws.counts.push_back(drawCounts[i]);
+        draws.offsets.push_back(drawOffsets[i]);
+        draws.baseVertices.push_back(baseVertex);
     }
 }
 
 void Terrain::cleanup() {
-    glDeleteBuffers(1, &vertexBufferID);
-    glDeleteBuffers(1, &indexBufferID);
-    glDeleteVertexArrays(1, &vertexArrayID);
-    glDeleteBuffers(1, &uvBufferID);
-    glDeleteTextures(1, &textureID);
-    glDeleteFramebuffers(1, &fbo);
+    if (pool) pool->release(page);
+    page = -1;
+    grid.reset();
 }
@@ -2,62 +2,177 @@
 #define TERRAIN_H
 
 #include <future>
+#include <memory>
 #include <vector>
 #include <glm/glm.hpp>
 #include "glad/gl.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "UploadRing.h"
+#include "TerrainVertexPool.h"
+#include "TerrainGrid.h"
+
+class TerrainCache;
+class TerrainNoiseGraph;
+class TerrainHeightfield;
+
+// Packed terrain vertex, 4 bytes instead of a vec3 position and a vec3 normal. x and z are implied
+// by the vertex's place in the grid and rebuilt in terrain.vert from gl_VertexID and the chunk origin.
+struct TerrainVertex {
+    GLushort height;    // [-maxHeight, maxHeight] mapped to [0, 65535]
+    GLbyte normal[2];   // Octahedral-encoded unit normal, x and z in [-127, 127]
+};
+static_assert(sizeof(TerrainVertex) == 4, "TerrainVertex must stay tightly packed");
 
 struct TerrainData {
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
+    std::vector<TerrainVertex> vertices;
+
+    // Chunks loaded from the TerrainCache leave vertices empty and point into the mapped file instead
+    std::shared_ptr<MappedFile> mappedFile;
+    const TerrainVertex* mappedVertices = nullptr;
+    size_t mappedVertexCount = 0;
+
+    const TerrainVertex* vertexData() const { return mappedFile ? mappedVertices : vertices.data(); }
+    size_t vertexCount() const { return mappedFile ? mappedVertexCount : vertices.size(); }
+
+    // Set when the job wrote the vertices into an UploadRing slot; nothing else is kept then
+    int stagingSlot = -1;
+    size_t stagedBytes = 0;
+
+    // World x and z of the chunk's first vertex
+    float originX = 0.0f;
+    float originZ = 0.0f;
+
+    // Lowest and highest vertex, for the chunk's bounding box
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+
+    // Largest height difference between the full grid and each LOD level, in world units
+    float lodErrors[TERRAIN_LOD_LEVELS];
+
+    // The vertices' heights, kept on the CPU for TerrainManager's height queries
+    std::shared_ptr<const TerrainHeightfield> heightfield;
+};
+
+// Index buffer and placeholder tile for one chunk resolution. The grid topology is identical for every
+// chunk, so TerrainManager builds these once per resolution and shares them between chunks.
+// The inherited layout locates every LOD level inside indexBufferID.
+struct TerrainGridBuffers : public TerrainGridLayout {
+    int width = 0;
+    int depth = 0;
+
+    GLuint indexBufferID = 0;
+
+    // Flat tile at height zero with up normals, copied into chunks until their terrain arrives
+    GLuint placeholderBufferID = 0;
+
+    // Index and placeholder bytes, for memory reports
+    size_t gpuBytes = 0;
+
+    // Number of chunks using these buffers
+    int refCount = 0;
 };
 
+// Index ranges of every visible chunk, drawn with one glMultiDrawElementsBaseVertex
+struct TerrainDrawList {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    void clear() { counts.clear(); offsets.clear(); baseVertices.clear(); }
+    bool empty() const { return counts.empty(); }
+    GLsizei size() const { return static_cast<GLsizei>(counts.size()); }
+};
+
+// One chunk of terrain. Its vertices live in a page of the TerrainVertexPool; TerrainManager draws
+// all chunks together from the draw ranges each one appends.
 class Terrain {
 public:
-    std::future<TerrainData> generateTerrainAsync(int width, int depth, float maxHeight, float posX, float posZ);
+    // Queues generation on the shared JobSystem. Cancelling the token drops the job if it has not
+    // started yet, otherwise it stops early and returns empty data. With a staging slot, the job
+    // writes the finished vertices into it instead of returning them.
+    std::future<TerrainData> generateTerrainAsync(int width, int depth, float maxHeight, float posX, float posZ,
+                                                  CancelToken cancelToken = CancelToken(),
+                                                  StagingSlot staging = StagingSlot());
 
+    // Copy finished data into the chunk's page. Staged data is copied on the GPU through the
+    // upload ring; anything else goes through glBufferSubData.
     void updateBuffers(const TerrainData& data);
 
-    void setProgramIDs(GLuint inputProgramID, GLuint inputDepthProgramID);
+    // Generation jobs look chunks up in the cache first and save what they generate.
+    // The cache must outlive every job started while it was set.
+    void setCache(TerrainCache* inputCache) { cache = inputCache; }
+
+    // Heights for jobs started from now on; the "classic" graph until one is set
+    void setNoiseGraph(const std::shared_ptr<const TerrainNoiseGraph>& graph) { noiseGraph = graph; }
+
+    // Ring that owns the staging slots passed to generateTerrainAsync
+    void setUploadRing(UploadRing* inputUploads) { uploads = inputUploads; }
+
+    // Quantize a height and normal into the packed vertex format
+    static TerrainVertex packVertex(float height, const glm::vec3& normal, float maxHeight);
+
+    // Takes a page of the pool and fills it with the flat placeholder tile; the real terrain comes
+    // from generateTerrainAsync and updateBuffers, so this never waits for generation
+    void initialize(const std::shared_ptr<TerrainGridBuffers>& gridBuffers, TerrainVertexPool* vertexPool,
+                    float maxHeight, float posX = 0.0f, float posZ = 0.0f);
+
+    // Add the index ranges of the current LOD selection, offset to this chunk's page
+    void appendDraws(TerrainDrawList& draws) const;
 
-    void initialize(int width, int depth, float maxHeight, float posX = 0.0f, float posZ = 0.0f);
+    // The pool moves pages when it is resized
+    int getPage() const { return page; }
+    void setPage(int newPage) { page = newPage; }
 
-    void render(glm::mat4 vp, glm::mat4 lightSpaceMatrix, glm::vec3 lightDirection, glm::vec3 lightIntensity, glm::vec3 cameraPos);
+    // Select the LOD level to draw. neighbourLevels holds the level of the chunk across each
+    // TerrainEdge; an edge is stitched when that neighbour is coarser. TerrainManager keeps
+    // neighbours within one level of each other. Returns true if the drawn geometry changed.
+    bool setLod(int level, const int neighbourLevels[EDGE_COUNT]);
+    int getLod() const { return lodLevel; }
 
+    // World-space error of drawing this chunk at the given level instead of at full resolution
+    float getGeometricError(int level) const { return geometricErrors[level]; }
+
+    // Number of triangles the current LOD selection draws
+    int getTriangleCount() const;
+
+    // World-space bounding box of the geometry currently in the chunk's page
+    glm::vec3 getBoundsMin() const;
+    glm::vec3 getBoundsMax() const;
+
+    // Gives the page back to the pool
     void cleanup();
 
+    // Build and upload the shared index buffer for a width x depth grid, all LOD levels included,
+    // and the flat placeholder tile
+    static std::shared_ptr<TerrainGridBuffers> createGridBuffers(int width, int depth, float maxHeight);
+    static void deleteGridBuffers(TerrainGridBuffers& gridBuffers);
+
+    const std::shared_ptr<TerrainGridBuffers>& getGridBuffers() const { return grid; }
+
 private:
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<GLuint> indices;
-    std::vector<glm::vec3> normals;
-
-    // OpenGL buffers
-    GLuint vertexArrayID;
-    GLuint vertexBufferID;
-    GLuint indexBufferID;
-    GLuint normalBufferID;
-    GLuint lightIntensityID;
-    GLuint lightDirectionID;
-    GLuint cameraPosID;
-    GLuint uvBufferID;
-    GLuint textureID;
-
-    // Shader variable IDs
-    GLuint mvpMatrixID;
-    GLuint modelMatrixIDRender;
-    GLuint modelMatrixIDDepth;
-    GLuint textureSamplerID;
-    GLuint programID = 0;
-
-    // Variables for depth mapping
-    GLuint fbo;
-    GLuint depthTexture;
-    GLuint depthProgramID = 0;
-    GLuint lightSpaceMatrixIDRender;
-    GLuint lightSpaceMatrixIDDepth;
-    GLuint depthTextureSamplerID;
-
-    std::mutex bufferMutex;
+    std::shared_ptr<TerrainGridBuffers> grid;
+    TerrainVertexPool* pool = nullptr;
+    int page = -1;
+    TerrainCache* cache = nullptr;
+    std::shared_ptr<const TerrainNoiseGraph> noiseGraph;
+    UploadRing* uploads = nullptr;
+
+    // Current LOD selection and the index ranges it draws: the interior then the four edges
+    int lodLevel = 0;
+    int stitchedEdges[EDGE_COUNT] = { 0, 0, 0, 0 };
+    GLsizei drawCounts[EDGE_COUNT + 1];
+    const void* drawOffsets[EDGE_COUNT + 1];
+    float geometricErrors[TERRAIN_LOD_LEVELS];
+
+    void updateDrawRanges();
+
+    // Placement of the data currently in the chunk's page
+    float originX = 0.0f;
+    float originZ = 0.0f;
+    float maxHeight = 0.0f;
+    float boundsMinY = 0.0f;
+    float boundsMaxY = 0.0f;
 };
 
 #endif
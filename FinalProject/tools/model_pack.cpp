@@ -0,0 +1,165 @@
+// Offline packer for the static glTF models: writes the ModelPack file the game maps at startup.
+// Every primitive is flattened to interleaved vertices and GL-ready indices, and every image is
+// decoded once, converted to RGBA8 and given its whole mip chain, so the game only uploads.
+// Models are stored under the path given here, so pass the same paths the game loads, from the
+// directory the game runs in, and rerun the packer whenever a model or its textures change.
+//
+// usage: model_pack <output.pack> <model.gltf|model.glb>...
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <tiny_gltf.h>
+
+#include "ModelPackBuilder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Element i of a float accessor with `components` components; false if the accessor is not float
+static bool readFloats(const tinygltf::Model& model, int accessorIndex, size_t i, int components, float* out) {
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.bufferView < 0) return false;
+
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+    size_t stride = accessor.ByteStride(bufferView);
+    size_t offset = bufferView.byteOffset + accessor.byteOffset + i * stride;
+    if (offset + components * sizeof(float) > buffer.data.size()) return false;
+
+    std::memcpy(out, &buffer.data[offset], components * sizeof(float));
+    return true;
+}
+
+static bool readIndex(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t i, uint32_t& out) {
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+    size_t stride = accessor.ByteStride(bufferView);
+    size_t offset = bufferView.byteOffset + accessor.byteOffset + i * stride;
+    if (offset + stride > buffer.data.size()) return false;
+
+    const unsigned char* data = &buffer.data[offset];
+    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        out = data[0];
+    } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        out = value;
+    } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        std::memcpy(&out, data, sizeof(out));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Same primitives as CityManager::uploadModel: every indexed primitive of every node with a mesh
+static bool addModel(PackBuilder& pack, const std::string& path) {
+    if (!beginPackModel(pack, path)) {
+        std::fprintf(stderr, "Path too long for the pack: %s\n", path.c_str());
+        return false;
+    }
+
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model model;
+    std::string err;
+    std::string warn;
+    bool binary = path.size() > 4 && path.compare(path.size() - 4, 4, ".glb") == 0;
+    bool res = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, path)
+                      : loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    if (!warn.empty()) std::fprintf(stderr, "WARN: %s\n", warn.c_str());
+    if (!err.empty()) std::fprintf(stderr, "ERR: %s\n", err.c_str());
+    if (!res) {
+        std::fprintf(stderr, "Failed to load glTF: %s\n", path.c_str());
+        return false;
+    }
+
+    for (const auto& node : model.nodes) {
+        if (node.mesh < 0) continue;
+        for (const auto& primitive : model.meshes[node.mesh].primitives) {
+            if (primitive.indices < 0) continue;
+
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end()) continue;
+            auto normal = primitive.attributes.find("NORMAL");
+            auto texCoord = primitive.attributes.find("TEXCOORD_0");
+
+            size_t vertexCount = model.accessors[position->second].count;
+            std::vector<PackVertex> vertices(vertexCount);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                PackVertex vertex = {};
+                bool read = readFloats(model, position->second, i, 3, vertex.position);
+                if (read && normal != primitive.attributes.end()) read = readFloats(model, normal->second, i, 3, vertex.normal);
+                if (read && texCoord != primitive.attributes.end()) read = readFloats(model, texCoord->second, i, 2, vertex.texCoord);
+                if (!read) {
+                    std::fprintf(stderr, "%s: only float vertex attributes can be packed\n", path.c_str());
+                    return false;
+                }
+                vertices[i] = vertex;
+            }
+
+            const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
+            std::vector<uint32_t> indices(indexAccessor.count);
+            for (size_t i = 0; i < indexAccessor.count; ++i) {
+                if (!readIndex(model, indexAccessor, i, indices[i])) {
+                    std::fprintf(stderr, "%s: invalid index buffer\n", path.c_str());
+                    return false;
+                }
+            }
+
+            int texture = -1;
+            if (primitive.material >= 0) {
+                int textureIndex = model.materials[primitive.material].pbrMetallicRoughness.baseColorTexture.index;
+                if (textureIndex >= 0 && textureIndex < static_cast<int>(model.textures.size())) {
+                    int source = model.textures[textureIndex].source;
+                    const tinygltf::Image& image = model.images[source];
+                    bool external = !image.uri.empty() && image.uri.compare(0, 5, "data:") != 0;
+                    std::string key = external ? directoryOf(path) + image.uri : path + "#" + std::to_string(source);
+
+                    // Only 8-bit images can be packed; zero components marks the others as unsupported
+                    bool known = pack.textureIndices.count(key) != 0;
+                    int components = image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE ? image.component : 0;
+                    texture = addPackTexture(pack, key, image.width, image.height, components, image.image.data());
+                    if (texture < 0 && !known) std::fprintf(stderr, "%s: skipped unsupported image %s\n", path.c_str(), key.c_str());
+                }
+            }
+
+            uint32_t indexType = indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT
+                               ? PACK_UNSIGNED_INT : PACK_UNSIGNED_SHORT;
+            if (!addPackPrimitive(pack, vertices, indices, indexType, texture)) {
+                std::fprintf(stderr, "%s: invalid index buffer\n", path.c_str());
+                return false;
+            }
+        }
+    }
+
+    std::printf("Packed %s: %u primitives\n", path.c_str(), pack.models.back().primitiveCount);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: model_pack <output.pack> <model.gltf|model.glb>...\n");
+        return 1;
+    }
+
+    PackBuilder pack;
+    for (int i = 2; i < argc; ++i) {
+        if (!addModel(pack, argv[i])) return 1;
+    }
+    if (!writePack(pack, argv[1])) return 1;
+
+    // Read it back the way the game does
+    ModelPack check;
+    if (!check.open(argv[1])) return 1;
+    std::printf("Wrote %s: %zu models, %zu textures, %.1f MB\n", argv[1], pack.models.size(), pack.textures.size(),
+                check.getBytes() / (1024.0 * 1024.0));
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Writes a small model pack with PackBuilder and reads it back through ModelPack: vertices, 16- and
+// 32-bit indices, a texture shared by two models and its mip chain must come back as written. Copies
+// of the pack that are truncated or point outside the file must then be rejected by ModelPack::open.
+// Runs in the current directory and removes its files. Returns nonzero if any check fails.
+//
+// usage: model_pack_test
+
+#include "ModelPackBuilder.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static const char* PACK_PATH = "model_pack_test.pack";
+static const char* DAMAGED_PATH = "model_pack_test_damaged.pack";
+
+static bool pass = true;
+
+static void check(bool condition, const char* what) {
+    std::printf("  %s: %s\n", what, condition ? "ok" : "FAILED");
+    pass = pass && condition;
+}
+
+static std::vector<PackVertex> makeVertices(int count, float seed) {
+    std::vector<PackVertex> vertices(count);
+    for (int i = 0; i < count; ++i) {
+        PackVertex& vertex = vertices[i];
+        for (int c = 0; c < 3; ++c) vertex.position[c] = seed + i * 3 + c;
+        for (int c = 0; c < 3; ++c) vertex.normal[c] = c == 1 ? 1.0f : 0.0f;
+        vertex.texCoord[0] = i * 0.25f;
+        vertex.texCoord[1] = seed;
+    }
+    return vertices;
+}
+
+// 4x2 RGB image: level 0 gets alpha 255, level 1 (2x1) averages each 2x2 block, level 2 is 1x1
+static const unsigned char IMAGE[4 * 2 * 3] = {
+    0, 10, 20,    4, 14, 24,    100, 0, 0,    200, 0, 0,
+    8, 18, 28,   12, 22, 32,      0, 0, 40,     0, 0, 80,
+};
+
+static bool writeTestPack(std::vector<PackVertex>& shortVertices, std::vector<uint32_t>& shortIndices,
+                          std::vector<PackVertex>& intVertices, std::vector<uint32_t>& intIndices) {
+    PackBuilder pack;
+
+    // 70000 vertices so the 32-bit indices really need 32 bits
+    shortVertices = makeVertices(4, 1.0f);
+    shortIndices = { 0, 1, 2, 2, 3, 0 };
+    intVertices = makeVertices(70000, 2.0f);
+    intIndices = { 0, 69999, 65536 };
+
+    beginPackModel(pack, "first.gltf");
+    int texture = addPackTexture(pack, "shared.png", 4, 2, 3, IMAGE);
+    if (!addPackPrimitive(pack, shortVertices, shortIndices, PACK_UNSIGNED_SHORT, texture)) return false;
+    if (!addPackPrimitive(pack, intVertices, intIndices, PACK_UNSIGNED_INT, -1)) return false;
+
+    // The same key again must reuse the texture, whatever pixels come with it
+    beginPackModel(pack, "second.gltf");
+    int sharedTexture = addPackTexture(pack, "shared.png", 1, 1, 4, IMAGE);
+    if (!addPackPrimitive(pack, shortVertices, shortIndices, PACK_UNSIGNED_SHORT, sharedTexture)) return false;
+
+    // Indices past the vertices, or too large for 16 bits, are refused
+    if (addPackPrimitive(pack, shortVertices, { 0, 4 }, PACK_UNSIGNED_SHORT, -1)) return false;
+    if (addPackPrimitive(pack, intVertices, { 65536 }, PACK_UNSIGNED_SHORT, -1)) return false;
+
+    return writePack(pack, PACK_PATH);
+}
+
+static bool samePrimitive(const ModelPack& pack, const PackPrimitive& primitive, const std::vector<PackVertex>& vertices,
+                          const std::vector<uint32_t>& indices, uint32_t indexType) {
+    if (primitive.vertexCount != vertices.size() || primitive.indexCount != indices.size()
+        || primitive.indexType != indexType) {
+        return false;
+    }
+    if (std::memcmp(pack.at(primitive.vertexOffset), vertices.data(), vertices.size() * sizeof(PackVertex)) != 0) return false;
+
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t index;
+        if (indexType == PACK_UNSIGNED_SHORT) {
+            uint16_t value;
+            std::memcpy(&value, static_cast<const unsigned char*>(pack.at(primitive.indexOffset)) + i * sizeof(value), sizeof(value));
+            index = value;
+        } else {
+            std::memcpy(&index, static_cast<const unsigned char*>(pack.at(primitive.indexOffset)) + i * sizeof(index), sizeof(index));
+        }
+        if (index != indices[i]) return false;
+    }
+    return true;
+}
+
+static void checkContents(const std::vector<PackVertex>& shortVertices, const std::vector<uint32_t>& shortIndices,
+                          const std::vector<PackVertex>& intVertices, const std::vector<uint32_t>& intIndices) {
+    std::printf("Reading %s\n", PACK_PATH);
+    ModelPack pack;
+    check(pack.open(PACK_PATH), "opens");
+    if (!pack.isOpen()) return;
+
+    const PackModel* first = pack.findModel("first.gltf");
+    const PackModel* second = pack.findModel("second.gltf");
+    check(first && first->primitiveCount == 2 && second && second->primitiveCount == 1, "models and primitive counts");
+    check(pack.findModel("missing.gltf") == nullptr, "unknown model is not found");
+    if (!first || !second || first->primitiveCount != 2 || second->primitiveCount != 1) return;
+
+    const PackPrimitive& shortPrimitive = pack.getPrimitive(first->firstPrimitive);
+    const PackPrimitive& intPrimitive = pack.getPrimitive(first->firstPrimitive + 1);
+    const PackPrimitive& secondPrimitive = pack.getPrimitive(second->firstPrimitive);
+    check(samePrimitive(pack, shortPrimitive, shortVertices, shortIndices, PACK_UNSIGNED_SHORT), "vertices and 16-bit indices");
+    check(samePrimitive(pack, intPrimitive, intVertices, intIndices, PACK_UNSIGNED_INT), "vertices and 32-bit indices");
+    check(shortPrimitive.vertexOffset % PACK_ALIGNMENT == 0 && intPrimitive.indexOffset % PACK_ALIGNMENT == 0, "blobs aligned");
+
+    check(pack.getTextureCount() == 1 && shortPrimitive.texture == 0 && secondPrimitive.texture == 0
+          && intPrimitive.texture == -1, "one texture shared by both models");
+    if (pack.getTextureCount() != 1) return;
+
+    const PackTexture& texture = pack.getTexture(0);
+    const uint32_t sizes[][2] = { { 4, 2 }, { 2, 1 }, { 1, 1 } };
+    bool chain = texture.width == 4 && texture.height == 2 && texture.levelCount == 3;
+    for (uint32_t level = 0; chain && level < texture.levelCount; ++level) {
+        const PackLevel& packLevel = pack.getLevel(texture.firstLevel + level);
+        chain = packLevel.width == sizes[level][0] && packLevel.height == sizes[level][1];
+    }
+    check(chain, "mip chain 4x2, 2x1, 1x1");
+    if (!chain) return;
+
+    const unsigned char* level0 = static_cast<const unsigned char*>(pack.at(pack.getLevel(texture.firstLevel).offset));
+    const unsigned char* level1 = static_cast<const unsigned char*>(pack.at(pack.getLevel(texture.firstLevel + 1).offset));
+    const unsigned char* level2 = static_cast<const unsigned char*>(pack.at(pack.getLevel(texture.firstLevel + 2).offset));
+    const unsigned char expected0[4] = { 4, 14, 24, 255 };      // Second texel of the first row
+    const unsigned char expected1[8] = { 6, 16, 26, 255, 75, 0, 30, 255 };
+    const unsigned char expected2[4] = { 41, 8, 28, 255 };
+    check(std::memcmp(level0 + 4, expected0, 4) == 0, "level 0 converted to RGBA8");
+    check(std::memcmp(level1, expected1, 8) == 0 && std::memcmp(level2, expected2, 4) == 0, "mips average 2x2 texels");
+}
+
+// Whether ModelPack opens the first `size` bytes of the pack with `count` bytes at `offset` replaced
+static bool openDamaged(const std::vector<char>& original, size_t size, size_t offset, const void* bytes, size_t count) {
+    std::vector<char> data(original.begin(), original.begin() + size);
+    if (count > 0) std::memcpy(&data[offset], bytes, count);
+    std::ofstream(DAMAGED_PATH, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+
+    ModelPack pack;
+    return pack.open(DAMAGED_PATH);
+}
+
+static void checkRejections() {
+    std::printf("Damaged copies of %s\n", PACK_PATH);
+    std::ifstream in(PACK_PATH, std::ios::binary);
+    std::vector<char> original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    PackHeader header;
+    std::memcpy(&header, original.data(), sizeof(header));
+    const size_t primitivesAt = sizeof(PackHeader) + header.modelCount * sizeof(PackModel);
+    const size_t texturesAt = primitivesAt + header.primitiveCount * sizeof(PackPrimitive);
+    const size_t levelsAt = texturesAt + header.textureCount * sizeof(PackTexture);
+
+    check(openDamaged(original, original.size(), 0, nullptr, 0), "undamaged copy opens");
+    check(!openDamaged(original, original.size() - PACK_ALIGNMENT, 0, nullptr, 0), "truncated blobs");
+    check(!openDamaged(original, sizeof(PackHeader) - 1, 0, nullptr, 0), "truncated header");
+
+    // fileSize still matches from here on, so only the range checks can catch these
+    const uint64_t pastEnd = original.size() - 8;
+    const uint32_t hugeCount = 0x40000000;
+    const int32_t missingTexture = 1;
+    check(!openDamaged(original, original.size(), offsetof(PackHeader, primitiveCount), &hugeCount, sizeof(hugeCount)),
+          "table count past the end");
+    check(!openDamaged(original, original.size(), sizeof(PackHeader) + offsetof(PackModel, primitiveCount), &hugeCount,
+                       sizeof(hugeCount)), "model primitives out of range");
+    check(!openDamaged(original, original.size(), primitivesAt + offsetof(PackPrimitive, vertexOffset), &pastEnd,
+                       sizeof(pastEnd)), "vertices past the end");
+    check(!openDamaged(original, original.size(), primitivesAt + offsetof(PackPrimitive, indexOffset), &pastEnd,
+                       sizeof(pastEnd)), "indices past the end");
+    check(!openDamaged(original, original.size(), primitivesAt + offsetof(PackPrimitive, texture), &missingTexture,
+                       sizeof(missingTexture)), "texture index out of range");
+    check(!openDamaged(original, original.size(), texturesAt + offsetof(PackTexture, levelCount), &hugeCount,
+                       sizeof(hugeCount)), "texture levels out of range");
+    check(!openDamaged(original, original.size(), levelsAt + offsetof(PackLevel, offset), &pastEnd, sizeof(pastEnd)),
+          "level texels past the end");
+
+    std::remove(DAMAGED_PATH);
+}
+
+int main() {
+    std::vector<PackVertex> shortVertices, intVertices;
+    std::vector<uint32_t> shortIndices, intIndices;
+    if (!writeTestPack(shortVertices, shortIndices, intVertices, intIndices)) {
+        std::printf("Failed to build %s\n", PACK_PATH);
+        return 1;
+    }
+
+    checkContents(shortVertices, shortIndices, intVertices, intIndices);
+    checkRejections();
+    std::remove(PACK_PATH);
+
+    std::printf(pass ? "All checks passed\n" : "Some checks FAILED\n");
+    return pass ? 0 : 1;
+}
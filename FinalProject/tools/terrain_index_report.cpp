@@ -0,0 +1,65 @@
+// Offline report of how the terrain index buffer uses the post-transform vertex cache.
+// For each chunk size and LOD level it compares plain row order with the strip order the game
+// uses, on simulated FIFO caches, and counts the vertex shader invocations the strips save.
+//
+// usage: terrain_index_report [chunk sizes...]    (default: 100 200 500 1000)
+
+#include "TerrainGrid.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const int CACHE_SIZES[] = { 16, 32 };
+
+// Every piece a chunk draws at one level with no coarser neighbours: the interior and the plain bands
+static VertexCacheStats analyzeLevel(const std::vector<GLuint>& indices, const TerrainGridLayout& layout,
+                                     int level, int cacheSize) {
+    std::vector<GLuint> drawn;
+    auto append = [&](const TerrainIndexRange& range) {
+        const GLuint* first = indices.data() + range.offset / sizeof(GLuint);
+        drawn.insert(drawn.end(), first, first + range.count);
+    };
+
+    append(layout.interior[level]);
+    for (int edge = 0; edge < EDGE_COUNT; ++edge) append(layout.edges[level][edge][0]);
+
+    return analyzeVertexCache(drawn.data(), drawn.size(), cacheSize);
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> chunkSizes;
+    for (int i = 1; i < argc; ++i) chunkSizes.push_back(std::atoi(argv[i]));
+    if (chunkSizes.empty()) chunkSizes = { 100, 200, 500, 1000 };
+
+    std::printf("Strips of %d quads, tuned for a %d-entry FIFO cache\n\n",
+                terrainStripQuads(TERRAIN_VERTEX_CACHE_SIZE), TERRAIN_VERTEX_CACHE_SIZE);
+
+    for (int size : chunkSizes) {
+        if (size <= 0) continue;
+
+        std::vector<GLuint> rowIndices, stripIndices;
+        TerrainGridLayout rowLayout, stripLayout;
+        buildTerrainGridIndices(size, size, size, rowIndices, rowLayout);
+        buildTerrainGridIndices(size, size, terrainStripQuads(TERRAIN_VERTEX_CACHE_SIZE), stripIndices, stripLayout);
+
+        std::printf("Chunk %dx%d\n", size, size);
+        std::printf("  level  cache  triangles   rows ACMR  ATVR   strips ACMR  ATVR   vs invocations saved\n");
+
+        for (int level = 0; level < stripLayout.levelCount; ++level) {
+            for (int cacheSize : CACHE_SIZES) {
+                VertexCacheStats rows = analyzeLevel(rowIndices, rowLayout, level, cacheSize);
+                VertexCacheStats strips = analyzeLevel(stripIndices, stripLayout, level, cacheSize);
+
+                long long saved = static_cast<long long>(rows.transformed) - static_cast<long long>(strips.transformed);
+                double percent = rows.transformed ? 100.0 * saved / rows.transformed : 0.0;
+                std::printf("  %5d  %5d  %9zu   %9.3f  %5.3f   %11.3f  %5.3f   %9lld  (%5.1f%%)\n",
+                            level, cacheSize, strips.triangles, rows.acmr(), rows.atvr(), strips.acmr(), strips.atvr(),
+                            saved, percent);
+            }
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
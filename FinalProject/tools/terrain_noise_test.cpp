@@ -0,0 +1,141 @@
+// Checks every terrain noise instruction set the CPU supports: plain fBm must match the
+// stb_perlin_noise3 octave loop it replaces within TOLERANCE over a fixed grid, and every fractal
+// type must be bit-identical to the plain C version, which keeps terrain the same on every machine.
+// Instruction sets the CPU lacks are reported as skipped. The "biomes" graph must then reproduce the
+// hash and heights recorded for a fixed seed, so changes to the generator do not go unnoticed; update
+// the constants only when the terrain is meant to change, along with the cache version.
+// Returns nonzero if any check fails.
+//
+// usage: terrain_noise_test
+
+#include "TerrainNoise.h"
+#include "TerrainNoiseGraph.h"
+#include "stb_perlin.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const float TOLERANCE = 1e-5f;
+static const int SEEDS[] = { 0, 42, 255 };
+
+// Every grid point, well away from the origin in both directions so the lattice wraps
+static void fillGrid(std::vector<float>& x, std::vector<float>& z) {
+    for (int row = -8; row <= 8; ++row) {
+        for (int column = -250; column <= 250; ++column) {
+            x.push_back(column * 11.3f + 0.25f);
+            z.push_back(row * 347.9f - 0.5f);
+        }
+    }
+}
+
+// The octave loop terrain used before the noise was vectorized
+static float stbFbm(const FbmParams& params, float x, float z) {
+    float frequency = params.scale;
+    float amplitude = 1.0f;
+    float value = 0.0f;
+    float maxAmplitude = 0.0f;
+    for (int o = 0; o < params.octaves; ++o) {
+        value += stb_perlin_noise3_seed(x * frequency, z * frequency, 0.0f, 0, 0, 0, params.seed) * amplitude;
+        maxAmplitude += amplitude;
+        amplitude *= params.persistence;
+        frequency *= params.lacunarity;
+    }
+    return value / maxAmplitude;
+}
+
+static bool checkAgainstStb(int kernel, const std::vector<float>& x, const std::vector<float>& z) {
+    std::vector<float> out(x.size());
+    float maxError = 0.0f;
+    for (int seed : SEEDS) {
+        FbmParams params;
+        params.seed = seed;
+        fractalNoiseOnKernel(kernel, params, x.data(), z.data(), static_cast<int>(x.size()), out.data());
+        for (size_t i = 0; i < x.size(); ++i) {
+            maxError = std::max(maxError, std::fabs(out[i] - stbFbm(params, x[i], z[i])));
+        }
+    }
+
+    bool pass = maxError <= TOLERANCE;
+    std::printf("  stb_perlin: max error %g %s\n", maxError, pass ? "ok" : "FAILED");
+    return pass;
+}
+
+static bool checkAgainstScalar(int kernel, int scalarKernel, const std::vector<float>& x, const std::vector<float>& z) {
+    const char* fractalNames[] = { "fbm", "ridged", "billow" };
+    std::vector<float> expected(x.size()), out(x.size());
+    bool pass = true;
+    for (int fractal = NOISE_FBM; fractal <= NOISE_BILLOW; ++fractal) {
+        FbmParams params;
+        params.seed = 42;
+        params.fractal = static_cast<NoiseFractal>(fractal);
+        params.offsetX = 17.0f;
+        params.offsetZ = 101.0f;
+        fractalNoiseOnKernel(scalarKernel, params, x.data(), z.data(), static_cast<int>(x.size()), expected.data());
+        fractalNoiseOnKernel(kernel, params, x.data(), z.data(), static_cast<int>(x.size()), out.data());
+
+        bool identical = std::memcmp(expected.data(), out.data(), x.size() * sizeof(float)) == 0;
+        std::printf("  %s: %s\n", fractalNames[fractal], identical ? "bit-identical to plain C" : "FAILED, differs from plain C");
+        pass = pass && identical;
+    }
+    return pass;
+}
+
+// "biomes" at BIOMES_SEED: the graph hash and heights at (-500 + BIOMES_COLUMNS[c], BIOMES_ROWS[r])
+static const uint32_t BIOMES_SEED = 42;
+static const uint64_t BIOMES_HASH = 0xac734c8866d53019ULL;
+static const float BIOMES_ROWS[] = { -1234.0f, 0.0f, 4321.0f };
+static const int BIOMES_COLUMNS[] = { 0, 333, 666, 999 };
+static const float BIOMES_HEIGHTS[3][4] = {
+    { -0.104020447f, 0.128982335f, -0.145463318f, -0.0890598074f },
+    { -0.14074555f, -0.485906541f, 0.400577784f, -0.00432473421f },
+    { -0.139333099f, -0.101531915f, -0.516285121f, 0.00683067366f },
+};
+
+static bool checkBiomesPreset() {
+    std::shared_ptr<const TerrainNoiseGraph> graph = TerrainNoiseGraph::createPreset("biomes", BIOMES_SEED);
+    bool pass = graph->getHash() == BIOMES_HASH;
+    std::printf("biomes, seed %u\n  hash %016llx %s\n", BIOMES_SEED, static_cast<unsigned long long>(graph->getHash()),
+                pass ? "ok" : "FAILED");
+
+    TerrainNoiseGraph::Scratch scratch;
+    std::vector<float> row(1000);
+    int mismatches = 0;
+    for (int r = 0; r < 3; ++r) {
+        graph->evaluateRow(-500.0f, BIOMES_ROWS[r], static_cast<int>(row.size()), row.data(), scratch);
+        for (int c = 0; c < 4; ++c) {
+            if (row[BIOMES_COLUMNS[c]] != BIOMES_HEIGHTS[r][c]) {
+                std::printf("  height at (%d, %g) is %.9g, expected %.9g\n", -500 + BIOMES_COLUMNS[c], BIOMES_ROWS[r],
+                            row[BIOMES_COLUMNS[c]], BIOMES_HEIGHTS[r][c]);
+                ++mismatches;
+            }
+        }
+    }
+    std::printf("  heights: %s\n", mismatches == 0 ? "ok" : "FAILED");
+    return pass && mismatches == 0;
+}
+
+int main() {
+    std::vector<float> x, z;
+    fillGrid(x, z);
+
+    int scalarKernel = fbmKernelCount() - 1;
+    bool pass = true;
+    for (int kernel = 0; kernel < fbmKernelCount(); ++kernel) {
+        if (!fbmKernelSupported(kernel)) {
+            std::printf("%s: skipped, not supported by this CPU\n", fbmKernelName(kernel));
+            continue;
+        }
+
+        std::printf("%s\n", fbmKernelName(kernel));
+        pass = checkAgainstStb(kernel, x, z) && pass;
+        if (kernel != scalarKernel) pass = checkAgainstScalar(kernel, scalarKernel, x, z) && pass;
+    }
+
+    pass = checkBiomesPreset() && pass;
+
+    std::printf(pass ? "All checks passed\n" : "Some checks FAILED\n");
+    return pass ? 0 : 1;
+}
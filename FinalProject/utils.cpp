@@ -30,10 +30,12 @@ GLuint LoadTextureTileBox(const char *texture_file_path) {
     return texture;
 }
 
-void createTerrainProgramIDs(GLuint& inputProgramID, GLuint& inputDepthProgramID) {
+void createTerrainProgramID(GLuint& inputProgramID) {
     inputProgramID = LoadShadersFromFile("../FinalProject/shader/terrain.vert", "../FinalProject/shader/terrain.frag");
     if (inputProgramID == 0) std::cerr << "Failed to load shaders." << std::endl;
+}
 
-    inputDepthProgramID = LoadShadersFromFile("../FinalProject/shader/depth.vert", "../FinalProject/shader/depth.frag");
-    if (inputDepthProgramID == 0) std::cerr << "Failed to load depth shaders." << std::endl;
-}
\ No newline at end of file
+void createTerrainDepthProgramID(GLuint& inputProgramID) {
+    inputProgramID = LoadShadersFromFile("../FinalProject/shader/terrain_depth.vert", "../FinalProject/shader/depth.frag");
+    if (inputProgramID == 0) std::cerr << "Failed to load terrain depth shaders." << std::endl;
+}
@@ -4,6 +4,7 @@
 
 GLuint LoadTextureTileBox(const char *texture_file_path);
 
-void createTerrainProgramIDs(GLuint& inputProgramID, GLuint& inputDepthProgramID);
+void createTerrainProgramID(GLuint& inputProgramID);
+void createTerrainDepthProgramID(GLuint& inputProgramID);
 
 #endif